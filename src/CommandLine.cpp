@@ -1,14 +1,29 @@
+#include <ssynth/Exception.h>
 #include <ssynth/Logging.h>
 #include <ssynth/Model/Builder.h>
+#include <ssynth/Model/Rendering/GlbRenderer.h>
 #include <ssynth/Model/Rendering/ObjRenderer.h>
+#include <ssynth/Model/Rendering/PipelinedRenderer.h>
+#include <ssynth/Model/Rendering/PlyRenderer.h>
+#include <ssynth/Model/Rendering/StlRenderer.h>
 #include <ssynth/Model/Rendering/TemplateRenderer.h>
+#include <ssynth/Model/RuleSetCache.h>
 #include <ssynth/Parser/EisenParser.h>
+#include <ssynth/Parser/ParameterSweep.h>
 #include <ssynth/Parser/Preprocessor.h>
 #include <ssynth/Parser/Tokenizer.h>
 
 #include <QCoreApplication>
 #include <QDebug>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
 class QLogger : public ssynth::Logging::Logger
 {
 public:
@@ -35,18 +50,180 @@ public:
   }
 };
 
+namespace
+{
+// Creates the renderer writing a .ply, .stl or .glb file.
+std::unique_ptr<ssynth::Model::Rendering::Renderer>
+createFileRenderer(const QString& output)
+{
+  using namespace ssynth::Model::Rendering;
+  if (output.endsWith(".ply", Qt::CaseInsensitive))
+    return std::make_unique<PlyRenderer>(output, 10, 10, true, false);
+  if (output.endsWith(".stl", Qt::CaseInsensitive))
+    return std::make_unique<StlRenderer>(output, 10, 10, true, false);
+  if (output.endsWith(".glb", Qt::CaseInsensitive))
+    return std::make_unique<GlbRenderer>(output, 10, 10);
+  throw ssynth::Exceptions::Exception("The output must be a .ply, .stl or .glb file.");
+}
+
+// Reads the parameter vectors of a sweep: one line per frame, made of 'name=value'
+// pairs separated by spaces. The missing parameters take their default values.
+// Empty lines and lines starting with '#' are skipped.
+std::vector<std::vector<double>>
+readSweep(const QString& fileName, const ssynth::Parser::ParameterSweep& sweep)
+{
+  QFile f(fileName);
+  if (!f.open(QIODevice::ReadOnly))
+    throw ssynth::Exceptions::Exception("Could not open the sweep file: " + fileName);
+  const QStringList lines = QString(f.readAll()).split('\n');
+
+  std::vector<std::vector<double>> vectors;
+  for (int i = 0; i < lines.size(); i++)
+  {
+    const QString line = lines[i].trimmed();
+    if (line.isEmpty() || line.startsWith('#'))
+      continue;
+    std::vector<double>& values = vectors.emplace_back(sweep.getDefaultValues());
+    for (const QString& pair : line.split(' ', Qt::SkipEmptyParts))
+    {
+      const int equal = pair.indexOf('=');
+      const int index = equal == -1 ? -1 : sweep.indexOf(pair.left(equal));
+      bool ok = false;
+      const double value = pair.mid(equal + 1).toDouble(&ok);
+      if (index == -1 || !ok)
+        throw ssynth::Exceptions::Exception(
+            QString("Sweep file, line %1: expected 'parameter=value'. Found: %2")
+                .arg(i + 1)
+                .arg(pair));
+      values[index] = value;
+    }
+  }
+  return vectors;
+}
+
+// Inserts the frame number before the extension: 'out.ply' -> 'out.0001.ply'.
+QString frameFileName(const QString& output, int frame)
+{
+  const int dot = output.lastIndexOf('.');
+  return output.left(dot) + QString(".%1").arg(frame, 4, 10, QChar('0'))
+         + output.mid(dot);
+}
+
+// Builds a frame per line of the sweep file, in parallel on 'threads' threads.
+void runSweep(
+    const QString& input,
+    const QString& sweepFile,
+    const QString& output,
+    int threads,
+    int seed)
+{
+  using namespace ssynth::Model;
+  if (output.isEmpty())
+    throw ssynth::Exceptions::Exception(
+        "A sweep needs an output file (-o), numbered for each frame.");
+  const char* const extensions[] = {".obj", ".ply", ".stl", ".glb"};
+  if (std::none_of(
+          std::begin(extensions),
+          std::end(extensions),
+          [&](const char* e) { return output.endsWith(e, Qt::CaseInsensitive); }))
+    throw ssynth::Exceptions::Exception(
+        "The sweep output must be a .obj, .ply, .stl or .glb file.");
+  const bool obj = output.endsWith(".obj", Qt::CaseInsensitive);
+
+  ssynth::Parser::ParameterSweep sweep(input, seed);
+  const std::vector<std::vector<double>> vectors = readSweep(sweepFile, sweep);
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // The frames are built in parallel, each by a single-threaded builder.
+  sweep.run(
+      vectors,
+      threads,
+      [&](int frame, RuleSet& ruleSet)
+      {
+        const QString fileName = frameFileName(output, frame);
+        if (obj)
+        {
+          QFile f(fileName);
+          if (!f.open(QIODevice::WriteOnly))
+            throw ssynth::Exceptions::Exception("Could not write: " + fileName);
+          Rendering::ObjRenderer renderer{10, 10, true, false};
+          Builder b(&renderer, &ruleSet, false);
+          b.setSeed(seed);
+          b.build();
+          Rendering::ObjWriter writer(f.handle());
+          renderer.write(writer);
+        }
+        else
+        {
+          std::unique_ptr<Rendering::Renderer> renderer = createFileRenderer(fileName);
+          renderer->begin();
+          Builder b(renderer.get(), &ruleSet, false);
+          b.setSeed(seed);
+          b.build();
+          renderer->end();
+        }
+      });
+}
+}
+
 auto main(int argc, char** argv) -> int
 {
   QCoreApplication app(argc, argv);
 
+  // Options: -j <threads> enables the parallel generation executor,
+  // -s <seed> sets the random seed,
+  // -w <epsilon> merges the OBJ vertices closer than epsilon across whole groups,
+  // --stream writes the OBJ groups while the structure is being built,
+  // --pipeline renders (and writes) the primitives on a second thread,
+  // -o <file> writes a binary .ply, .stl or .glb file instead of the OBJ output,
+  // -c <directory> caches the parsed scripts in the directory,
+  // --sweep <file> builds a frame for each line of GUI parameter values in the file
+  // (written to the -o file, numbered), -j frames at a time.
+  std::vector<const char*> args;
+  int threads = 0;
+  int seed = 0;
+  double weld = -1;
+  bool stream = false;
+  bool pipeline = false;
+  QString output;
+  QString cacheDirectory;
+  QString sweepFile;
+  auto isOption = [&](int i, const char* shortName, const char* longName)
+  {
+    return (strcmp(argv[i], shortName) == 0 || strcmp(argv[i], longName) == 0)
+           && i + 1 < argc;
+  };
+  for (int i = 0; i < argc; i++)
+  {
+    if (isOption(i, "-j", "--threads"))
+      threads = atoi(argv[++i]);
+    else if (isOption(i, "-s", "--seed"))
+      seed = atoi(argv[++i]);
+    else if (isOption(i, "-w", "--weld"))
+      weld = atof(argv[++i]);
+    else if (isOption(i, "-o", "--output"))
+      output = argv[++i];
+    else if (isOption(i, "-c", "--cache"))
+      cacheDirectory = argv[++i];
+    else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc)
+      sweepFile = argv[++i];
+    else if (strcmp(argv[i], "--stream") == 0)
+      stream = true;
+    else if (strcmp(argv[i], "--pipeline") == 0)
+      pipeline = true;
+    else
+      args.push_back(argv[i]);
+  }
+
   QString input;
-  if (argc > 1)
+  if (args.size() > 1)
   {
-    QFile f(argv[1]);
+    QFile f(args[1]);
     f.open(QIODevice::ReadOnly);
     input = f.readAll();
   }
-  else if (argc == 1)
+  else
   {
     input = R"_(set maxdepth 2000
 { a 0.9 hue 30 } R1
@@ -66,36 +243,87 @@ rule R1 w 10 {
   // QLogger l;
   try
   {
+    if (!sweepFile.isEmpty())
+    {
+      runSweep(input, sweepFile, output, threads, seed);
+      return 0;
+    }
+
     ssynth::Parser::Preprocessor p;
-    auto preprocessed = p.Process(input);
+    auto preprocessed = p.Process(input, seed);
 
-    ssynth::Parser::Tokenizer t{std::move(preprocessed)};
-    ssynth::Parser::EisenParser e{t};
+    // The cache is keyed by the preprocessed script, which depends on the seed only
+    // through the 'random[a,b]' statements.
+    std::unique_ptr<ssynth::Model::RuleSetCache> cache;
+    std::unique_ptr<ssynth::Model::RuleSet> ruleset;
+    if (!cacheDirectory.isEmpty())
+    {
+      cache = std::make_unique<ssynth::Model::RuleSetCache>(cacheDirectory);
+      ruleset.reset(cache->load(preprocessed));
+    }
+    if (!ruleset)
+    {
+      ssynth::Parser::Tokenizer t{preprocessed};
+      ssynth::Parser::EisenParser e{t};
+      e.setParameters(p.getParameters());
 
-    auto ruleset = std::unique_ptr<ssynth::Model::RuleSet>{e.parseRuleset()};
-    ruleset->resolveNames();
+      ruleset.reset(e.parseRuleset());
+      ruleset->resolveNames();
+      if (cache)
+        cache->store(preprocessed, *ruleset);
+    }
     ruleset->dumpInfo();
 
-    QTextStream ts(stdout);
-    if (argc > 2)
+    auto build = [&](ssynth::Model::Rendering::Renderer* renderer)
     {
-      QFile tplFile(argv[2]);
-      ssynth::Model::Rendering::Template tpl{tplFile};
-      ssynth::Model::Rendering::TemplateRenderer tr{tpl};
-      ssynth::Model::Builder b(&tr, ruleset.get(), true);
+      std::unique_ptr<ssynth::Model::Rendering::PipelinedRenderer> pipelined;
+      if (pipeline)
+      {
+        pipelined
+            = std::make_unique<ssynth::Model::Rendering::PipelinedRenderer>(renderer);
+        renderer = pipelined.get();
+      }
+      ssynth::Model::Builder b(renderer, ruleset.get(), true);
+      b.setThreadCount(threads);
+      b.setSeed(seed);
       b.build();
+      if (pipelined)
+        pipelined->sync();
+    };
 
-      ts << tr.getOutput();
+    if (args.size() > 2)
+    {
+      QFile tplFile(args[2]);
+      ssynth::Model::Rendering::Template tpl{tplFile};
+      ssynth::Model::Rendering::TemplateRenderer tr{tpl};
+      tr.setOutput(fileno(stdout));
+      tr.begin();
+      build(&tr);
+      tr.end();
+    }
+    else if (!output.isEmpty())
+    {
+      std::unique_ptr<ssynth::Model::Rendering::Renderer> renderer
+          = createFileRenderer(output);
+      renderer->begin();
+      build(renderer.get());
+      renderer->end();
     }
     else
     {
       ssynth::Model::Rendering::ObjRenderer obj{10, 10, true, false};
-      ssynth::Model::Builder b(&obj, ruleset.get(), true);
-      b.build();
-
-      obj.writeToStream(ts);
+      if (weld >= 0)
+        obj.setVertexWelding(weld, true);
+      ssynth::Model::Rendering::ObjWriter writer(fileno(stdout));
+      if (stream)
+        obj.setStreamWriter(&writer);
+      build(&obj);
+      obj.write(writer);
     }
-    ts.flush();
+  }
+  catch (ssynth::Exceptions::Exception& e)
+  {
+    fprintf(stderr, "%s\n", e.getMessage().toLocal8Bit().data());
   }
   catch (std::exception& e)
   {
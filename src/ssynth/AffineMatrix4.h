@@ -0,0 +1,173 @@
+#pragma once
+
+#include <ssynth/Matrix4.h>
+#include <ssynth/Vector3.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define SSYNTH_AFFINE_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSYNTH_AFFINE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE3__) || defined(__AVX__)
+#include <pmmintrin.h>
+#endif
+
+namespace ssynth
+{
+namespace Math
+{
+
+/// A 4x4 matrix where the bottom row is always (0,0,0,1),
+/// i.e. the transformations that can be built from EisenScript operators.
+///
+/// Only the upper 3x4 part is stored (row-major, 48 bytes), which allows the products
+/// to be computed row by row with SIMD instructions. The kernels are chosen at build
+/// time: AVX2+FMA, SSE2 or scalar code (see the SSYNTH_ENABLE_AVX2 CMake option).
+class AffineMatrix4f
+{
+public:
+  /// Constructor (inits to the identity).
+  AffineMatrix4f()
+  {
+    for (int i = 0; i < 12; i++)
+      v[i] = 0;
+    v[0] = 1;
+    v[5] = 1;
+    v[10] = 1;
+  }
+
+  /// Converts a matrix, the bottom row of 'm' is ignored.
+  explicit AffineMatrix4f(const Matrix4f& m)
+  {
+    for (int row = 0; row < 3; row++)
+      for (int col = 0; col < 4; col++)
+        v[row * 4 + col] = m(row, col);
+  }
+
+  static AffineMatrix4f Identity() { return AffineMatrix4f(); }
+
+  /// The matrix mapping the unit vectors to 'dir1', 'dir2' and 'dir3', and the origin
+  /// to 'base'.
+  static AffineMatrix4f
+  FromColumns(Vector3f dir1, Vector3f dir2, Vector3f dir3, Vector3f base)
+  {
+    AffineMatrix4f m(NoInit{});
+    for (int row = 0; row < 3; row++)
+    {
+      m(row, 0) = dir1[row];
+      m(row, 1) = dir2[row];
+      m(row, 2) = dir3[row];
+      m(row, 3) = base[row];
+    }
+    return m;
+  }
+
+  /// Returns a column (the translation for 'col' = 3).
+  Vector3f column(int col) const { return Vector3f(v[col], v[4 + col], v[8 + col]); }
+
+  Matrix4f toMatrix4() const
+  {
+    Matrix4f m;
+    for (int row = 0; row < 3; row++)
+      for (int col = 0; col < 4; col++)
+        m(row, col) = v[row * 4 + col];
+    m(3, 3) = 1;
+    return m;
+  }
+
+  /// at(row, col) return a copy of the value (row < 3).
+  float at(int row, int col) const { return v[row * 4 + col]; }
+  float operator()(int row, int col) const { return v[row * 4 + col]; }
+
+  /// Returns a reference (for writing into matrix). Only the upper three rows are stored.
+  float& operator()(int row, int col) { return v[row * 4 + col]; }
+
+  AffineMatrix4f operator*(const AffineMatrix4f& rhs) const
+  {
+    AffineMatrix4f m(NoInit{});
+#if defined(SSYNTH_AFFINE_AVX2)
+    // Rows 0 and 1 are computed in the two halves of a 256 bit register.
+    const __m256 r0 = _mm256_broadcast_ps((const __m128*)&rhs.v[0]);
+    const __m256 r1 = _mm256_broadcast_ps((const __m128*)&rhs.v[4]);
+    const __m256 r2 = _mm256_broadcast_ps((const __m128*)&rhs.v[8]);
+    const __m256 a01 = _mm256_load_ps(&v[0]);
+    __m256 c01 = _mm256_mul_ps(_mm256_permute_ps(a01, 0x00), r0);
+    c01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, 0x55), r1, c01);
+    c01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, 0xAA), r2, c01);
+    // The translation column: rhs has an implicit (0,0,0,1) bottom row.
+    c01 = _mm256_add_ps(c01, _mm256_blend_ps(_mm256_setzero_ps(), a01, 0x88));
+    _mm256_store_ps(&m.v[0], c01);
+
+    const __m128 a2 = _mm_load_ps(&v[8]);
+    __m128 c2 = _mm_mul_ps(_mm_permute_ps(a2, 0x00), _mm256_castps256_ps128(r0));
+    c2 = _mm_fmadd_ps(_mm_permute_ps(a2, 0x55), _mm256_castps256_ps128(r1), c2);
+    c2 = _mm_fmadd_ps(_mm_permute_ps(a2, 0xAA), _mm256_castps256_ps128(r2), c2);
+    c2 = _mm_add_ps(c2, _mm_blend_ps(_mm_setzero_ps(), a2, 0x8));
+    _mm_store_ps(&m.v[8], c2);
+#elif defined(SSYNTH_AFFINE_SSE2)
+    const __m128 r0 = _mm_load_ps(&rhs.v[0]);
+    const __m128 r1 = _mm_load_ps(&rhs.v[4]);
+    const __m128 r2 = _mm_load_ps(&rhs.v[8]);
+    const __m128 r3 = _mm_set_ps(1, 0, 0, 0);
+    for (int row = 0; row < 3; row++)
+    {
+      const float* a = &v[row * 4];
+      __m128 c = _mm_mul_ps(_mm_set1_ps(a[0]), r0);
+      c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(a[1]), r1));
+      c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(a[2]), r2));
+      c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(a[3]), r3));
+      _mm_store_ps(&m.v[row * 4], c);
+    }
+#else
+    for (int row = 0; row < 3; row++)
+    {
+      for (int col = 0; col < 4; col++)
+      {
+        float c = 0;
+        for (int i = 0; i < 3; i++)
+          c += at(row, i) * rhs.at(i, col);
+        m(row, col) = (col == 3) ? c + at(row, 3) : c;
+      }
+    }
+#endif
+    return m;
+  }
+
+  /// Transforms a point (the translation is applied).
+  Vector3f operator*(const Vector3f& p) const
+  {
+#if defined(__SSE3__) || defined(__AVX__)
+    const __m128 q = _mm_set_ps(1, p[2], p[1], p[0]);
+    const __m128 x = _mm_mul_ps(_mm_load_ps(&v[0]), q);
+    const __m128 y = _mm_mul_ps(_mm_load_ps(&v[4]), q);
+    const __m128 z = _mm_mul_ps(_mm_load_ps(&v[8]), q);
+    const __m128 xyz = _mm_hadd_ps(_mm_hadd_ps(x, y), _mm_hadd_ps(z, z));
+    alignas(16) float r[4];
+    _mm_store_ps(r, xyz);
+    return Vector3f(r[0], r[1], r[2]);
+#else
+    Vector3f r;
+    for (int row = 0; row < 3; row++)
+    {
+      for (int i = 0; i < 3; i++)
+        r[row] += at(row, i) * p[i];
+      r[row] += at(row, 3);
+    }
+    return r;
+#endif
+  }
+
+private:
+  struct NoInit
+  {
+  };
+  explicit AffineMatrix4f(NoInit) { }
+
+  alignas(32) float v[12];
+};
+
+}
+}
@@ -2,7 +2,6 @@
 #include <ssynth/Exception.h>
 #include <ssynth/Logging.h>
 #include <ssynth/Model/Builder.h>
-#include <ssynth/RandomStreams.h>
 
 #include <QFile>
 #include <QFileInfo>
@@ -79,35 +78,35 @@ ColorPool::~ColorPool()
   delete picture;
 }
 
-auto ColorPool::drawColor() -> QColor
+auto ColorPool::drawColor(Math::CounterRandomGenerator& random) -> QColor
 {
   if (type == RandomHue)
   {
-    return QColor::fromHsv(RandomStreams::Color()->getInt(359), 255, 255);
+    return QColor::fromHsv(random.getInt(359), 255, 255);
   }
   else if (type == GreyScale)
   {
-    int r = RandomStreams::Color()->getInt(255);
+    int r = random.getInt(255);
     return QColor(r, r, r).toHsv();
   }
   else if (type == RandomRGB)
   {
     // We can only pull one random number, so we must use a few tricks to get three ints
-    int r = RandomStreams::Color()->getInt(255);
-    int g = RandomStreams::Color()->getInt(255);
-    int b = RandomStreams::Color()->getInt(255);
+    int r = random.getInt(255);
+    int g = random.getInt(255);
+    int b = random.getInt(255);
     return QColor(r, g, b).toHsv();
   }
   else if (type == Picture)
   {
-    int x = RandomStreams::Color()->getInt(picture->width() - 1);
-    int y = RandomStreams::Color()->getInt(picture->height() - 1);
+    int x = random.getInt(picture->width() - 1);
+    int y = random.getInt(picture->height() - 1);
     QRgb rgb = picture->pixel(x, y);
     return QColor(rgb).toHsv();
   }
   else if (type == ColorList)
   {
-    int id = RandomStreams::Color()->getInt(colorList.size() - 1);
+    int id = random.getInt(colorList.size() - 1);
     return colorList[id];
   }
   return {};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <ssynth/Random.h>
+
 #include <QColor>
 #include <QImage>
 #include <QString>
@@ -27,7 +29,8 @@ class ColorPool
 public:
   ColorPool(QString initString);
   ~ColorPool();
-  QColor drawColor(); // returns a random color from the pool (in HSV)
+  // returns a random color from the pool (in HSV), drawn using 'random'.
+  QColor drawColor(Math::CounterRandomGenerator& random);
 private:
   PoolType type;
   std::vector<QColor> colorList; // only used by type: ColorList.
@@ -0,0 +1,41 @@
+#include <ssynth/Exception.h>
+#include <ssynth/FileUtils.h>
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ssynth
+{
+using namespace Exceptions;
+
+namespace Misc
+{
+
+void FileUtils::writeAll(int fd, const char* data, std::size_t size)
+{
+  while (size > 0)
+  {
+#ifdef _WIN32
+    const auto written = _write(fd, data, (unsigned int)size);
+#else
+    const auto written = ::write(fd, data, size);
+#endif
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      throw Exception(QString("Unable to write output: %1").arg(strerror(errno)));
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ssynth
+{
+namespace Misc
+{
+
+class FileUtils
+{
+public:
+  /// Writes 'size' bytes to the file descriptor 'fd' (continuing after partial writes).
+  /// Throws an Exception if the data can not be written.
+  static void writeAll(int fd, const char* data, std::size_t size);
+};
+
+}
+}
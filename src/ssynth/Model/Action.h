@@ -37,10 +37,11 @@ public:
 
   ~Action();
 
-  /// If 'callingRule' != 0 the new states generated will be set with
-  /// a depth equal to 'ruleDepth'
-  void apply(Builder* b, const Rule* callingRule, int ruleDepth) const;
   RuleRef* getRuleRef() const { return rule.get(); }
+  const std::vector<TransformationLoop>& getLoops() const { return loops; }
+  std::vector<TransformationLoop>& getLoops() { return loops; }
+  /// The command of a 'set' action (or nullptr).
+  const SetAction* getSetAction() const { return set.get(); }
 
 private:
   std::vector<TransformationLoop> loops;
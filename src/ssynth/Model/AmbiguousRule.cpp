@@ -1,7 +1,5 @@
 #include <ssynth/Logging.h>
 #include <ssynth/Model/AmbiguousRule.h>
-#include <ssynth/Model/Builder.h>
-#include <ssynth/RandomStreams.h>
 
 namespace ssynth
 {
@@ -23,32 +21,35 @@ auto AmbiguousRule::getRuleRefs() const -> std::vector<RuleRef*>
   return list;
 }
 
-void AmbiguousRule::apply(Builder* builder) const
+void AmbiguousRule::buildSelectionTable()
 {
-  // Calc sum of weigths
+  candidates.clear();
+  accumulatedWeights.clear();
+
   double totalWeight = 0;
   for (auto rule : rules)
   {
-    totalWeight += rule->getWeight();
+    if (rule->getWeight() > 0)
+    {
+      totalWeight += rule->getWeight();
+      candidates.push_back(rule);
+      accumulatedWeights.push_back(totalWeight);
+    }
   }
 
-  double random = totalWeight * RandomStreams::Geometry()->getDouble();
-
-  // Choose a random rule according to weights
-  double accWeight = 0;
-  for (auto rule : rules)
+  if (candidates.empty())
   {
-    accWeight += rule->getWeight();
-    if (random <= accWeight)
+    if (!rules.empty())
+      WARNING(QString("No positive weights for rule '%1' - all definitions will be "
+                      "equally likely.")
+                  .arg(getName()));
+    for (int i = 0; i < rules.size(); i++)
     {
-      rule->apply(builder);
-      return;
+      candidates.push_back(rules[i]);
+      accumulatedWeights.push_back(i + 1);
     }
   }
-  rules[rules.size() - 1]->apply(builder);
-
-  WARNING("Assertion failed: in AmbiguousRule::apply");
-};
+}
 
 }
 }
@@ -12,7 +12,7 @@ namespace Model
 /// an Ambiguous Rule is created which contains the multiple definitions.
 ///
 /// When the rule is executed, a random rule is chosen from the multiple definitions,
-/// taking their weights into account.
+/// taking their weights into account (see RuleProgram).
 class AmbiguousRule : public Rule
 {
 public:
@@ -20,8 +20,6 @@ public:
       : Rule(name){};
   ~AmbiguousRule() { qDeleteAll(rules); }
 
-  virtual void apply(Builder* builder) const;
-
   /// Returns a list over rules that this rule references.
   virtual std::vector<RuleRef*> getRuleRefs() const;
 
@@ -29,6 +27,19 @@ public:
 
   void appendRule(CustomRule* r) { rules.push_back(r); }
 
+  /// Builds the table used for choosing a rule. Must be called (by RuleSet::resolveNames)
+  /// after all rules have been appended and their weights are known.
+  ///
+  /// Rules with zero or negative weights are never chosen,
+  /// unless no rule has a positive weight: then all rules are equally likely.
+  void buildSelectionTable();
+
+  /// The definitions that can be chosen, and their accumulated weights: a definition
+  /// is chosen if it is the first whose accumulated weight is not below a random value
+  /// in [0;total weight).
+  const std::vector<const CustomRule*>& getCandidates() const { return candidates; }
+  const std::vector<double>& getAccumulatedWeights() const { return accumulatedWeights; }
+
   virtual void setMaxDepth(int maxDepth)
   {
     for (int i = 0; i < rules.size(); i++)
@@ -37,6 +48,10 @@ public:
 
 private:
   std::vector<CustomRule*> rules;
+
+  // The rules that can be chosen, and their accumulated weights.
+  std::vector<const CustomRule*> candidates;
+  std::vector<double> accumulatedWeights;
 };
 
 }
@@ -3,10 +3,13 @@
 #include <ssynth/Logging.h>
 #include <ssynth/MiniParser.h>
 #include <ssynth/Model/Builder.h>
-#include <ssynth/RandomStreams.h>
+#include <ssynth/Model/Rendering/RecordingRenderer.h>
 #include <ssynth/Vector3.h>
 
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
 
 namespace ssynth
 {
@@ -32,7 +35,73 @@ Builder::Builder(Rendering::Renderer* renderTarget, RuleSet* ruleSet, bool verbo
     , hasSeedChanged(false)
     , syncRandom(false)
     , initialSeed(0)
-    , colorPool{new ColorPool("RandomHue")} {};
+    , colorPool{std::make_shared<ColorPool>("RandomHue")} {};
+
+Builder::Builder(const Builder& parent, Rendering::Renderer* sink)
+    : userCancelled(false)
+    , renderTarget(sink)
+    , ruleSet(parent.ruleSet)
+    , verbose(false)
+    , maxGenerations(parent.maxGenerations)
+    , maxObjects(parent.maxObjects)
+    , objects(0)
+    , minDim(parent.minDim)
+    , maxDim(parent.maxDim)
+    , newSeed(0)
+    , hasSeedChanged(false)
+    , syncRandom(parent.syncRandom)
+    , trackPreviousState(parent.trackPreviousState)
+    , initialSeed(parent.initialSeed)
+    , colorPool(parent.colorPool)
+    , program(parent.program)
+{
+}
+
+namespace
+{
+// Generations smaller than this are not split across threads.
+constexpr int minimumChunkSize = 64;
+
+// The stream used for the 'set syncrandom' seeds.
+constexpr uint64_t syncStream = RandomStreams::firstReservedStream + 1;
+
+// The number of primitives sent to the renderer at once.
+constexpr int primitiveBatchSize = 1024;
+}
+
+auto Builder::addPrimitive(Rendering::PrimitiveRecord::Type type, PrimitiveClass* classID)
+    -> Rendering::PrimitiveRecord&
+{
+  if (primitives.size() >= primitiveBatchSize)
+    flushPrimitives();
+  else if (primitives.empty())
+    primitives.reserve(primitiveBatchSize);
+
+  Rendering::PrimitiveRecord& p = primitives.emplace_back();
+  p.type = type;
+  p.classID = classID;
+  const Vector3f rgb = Misc::ColorUtils::HSVtoRGB(activeState->hsv);
+  p.rgba[0] = rgb.x();
+  p.rgba[1] = rgb.y();
+  p.rgba[2] = rgb.z();
+  p.rgba[3] = activeState->alpha;
+  return p;
+}
+
+auto Builder::addMeshStart(Rendering::PrimitiveRecord& p) -> Rendering::MeshRecord&
+{
+  p.mesh = meshes.size();
+  return meshes.emplace_back();
+}
+
+void Builder::flushPrimitives()
+{
+  if (primitives.empty())
+    return;
+  renderTarget->drawPrimitives(primitives, meshes);
+  primitives.clear();
+  meshes.clear();
+}
 
 void Builder::recurseDepthFirst(
     ProgressDialog& progressDialog,
@@ -45,22 +114,59 @@ void Builder::recurseDepthFirst(
   if (maxGenerations > 0)
   {
     ruleSet->setRulesMaxDepth(maxGenerations);
+    program->updateMaxDepths();
   }
 
-  std::list<RuleState> ruleStates;
-  ruleStates.push_back(stack[0]);
-  while (ruleStates.size() != 0 && objects < maxObjects)
+  // The frames are reused, so memory only grows with the recursion depth.
+  // 'frames[top]' holds the state to be executed next (if 'next' is set).
+  std::vector<DepthFirstFrame> frames(1);
+  frames[0].state = stack[0].state;
+  int next = stack[0].rule;
+  int top = 0;
+  while (objects < maxObjects)
   {
+    if (next == -1)
+    {
+      if (top == 0)
+        break;
+
+      // Create the next state from the innermost frame.
+      if (frames.size() == top)
+      {
+        frames.emplace_back();
+      }
+      DepthFirstFrame& frame = frames[top - 1];
+      activeState = &frame.state;
+      currentState = &frame.state;
+      if (frame.nextExpanded < frame.expanded.size())
+      {
+        RuleState& child = frame.expanded[frame.nextExpanded++];
+        frames[top].state = std::move(child.state);
+        next = child.rule;
+        continue;
+      }
+      if (frame.cursor.done)
+      {
+        if (++frame.action < program->actionsEnd(frame.rule))
+        {
+          program->begin(this, frame.action, frame.cursor);
+        }
+        else
+        {
+          top--;
+        }
+        continue;
+      }
 
-    /*
-                QStringList l;
-                foreach (RuleState r, ruleStates) {
-                    QString name = r.rule->getName();
-                    int d = r.state.maxDepths[r.rule];
-                    l.push_back(QString("%1(%2)").arg(name).arg(d));
-                }
-                INFO(l.join(" "));
-                */
+      next = program->createChild(
+          this,
+          frame.action,
+          frame.cursor,
+          frame.depthId,
+          frame.depth,
+          frames[top].state);
+      continue;
+    }
 
     double p = 0;
     if (maxObjects > 0)
@@ -80,7 +186,7 @@ void Builder::recurseDepthFirst(
                                           "%1\r\nObjects: %2\r\nPending rules: %3")
                                       .arg(generationCounter)
                                       .arg(objects)
-                                      .arg(stack.size()));
+                                      .arg(top));
       //qApp->processEvents();
       if (progressDialog.wasCanceled())
       {
@@ -92,19 +198,21 @@ void Builder::recurseDepthFirst(
 
     generationCounter++; // Notice this does not make sense for depth first search.
 
-    // Now iterate though all RuleState's on stack and create next generation.
-    nextStack.clear();
-    currentState = &ruleStates.front().state;
+    // Execute the next state.
+    int rule = std::exchange(next, -1);
+    DepthFirstFrame& frame = frames[top];
+    currentState = &frame.state;
+    activeState = &frame.state;
     if (currentState->seed != 0)
     {
-      RandomStreams::SetSeed(currentState->seed);
-      currentState->seed = RandomStreams::Geometry()->getInt();
+      currentState->random.setSeed(currentState->seed);
+      currentState->seed = currentState->random.Geometry().getInt();
     }
-    state = ruleStates.front().state;
 
     // Check the dimensions against the min and max limits.
     if (maxDim != 0 || minDim != 0)
     {
+      const State& state = frame.state;
       Vector3f s = state.matrix * Vector3f(1, 1, 1) - state.matrix * Vector3f(0, 0, 0);
       double l = s.length();
       if (maxDim && l > maxDim)
@@ -119,16 +227,40 @@ void Builder::recurseDepthFirst(
       }
     }
 
-    ruleStates.front().rule->apply(this);
-    ruleStates.pop_front();
-
-    auto it = ruleStates.begin();
-
-    for (const RuleState& r : nextStack)
+    // Primitives are drawn right away, custom rules get a frame for their actions.
+    frame.rule = program->resolve(this, rule, frame.depth);
+    if (frame.rule != -1)
     {
-      ruleStates.insert(it, r);
+      frame.depthId = program->depthTrackingId(frame.rule);
+      frame.action = program->actionsBegin(frame.rule) - 1;
+      frame.cursor.done = true;
+      frame.expanded.clear();
+      frame.nextExpanded = 0;
+      if (program->reachesSetActions(frame.rule))
+      {
+        // As in the eager traversal, all children must be created before any of them
+        // is executed (and the rule's own 'set' actions run in order with their
+        // creation), when a 'set' action may run below: it would change the builder
+        // settings (e.g. the color pool) used to create the later children.
+        for (frame.action++; frame.action < program->actionsEnd(frame.rule);
+             frame.action++)
+        {
+          program->begin(this, frame.action, frame.cursor);
+          State child;
+          int childRule;
+          while ((childRule = program->createChild(
+                      this, frame.action, frame.cursor, frame.depthId, frame.depth, child))
+                 != -1)
+          {
+            frame.expanded.emplace_back(childRule, std::move(child));
+          }
+        }
+        frame.action--;
+      }
+      top++;
     }
   }
+  activeState = &state;
 }
 
 void Builder::recurseBreadthFirst(
@@ -138,18 +270,12 @@ void Builder::recurseBreadthFirst(
     int& generationCounter)
 {
   int syncSeed = 0;
-  if (syncRandom)
-  {
-    syncSeed = RandomStreams::Geometry()->getInt();
-  }
-
   int lastValue = 0;
 
   while (stack.size() != 0 && generationCounter < maxGenerations && objects < maxObjects
          && stack.size() < maxObjects)
   {
-
-    syncSeed = RandomStreams::Geometry()->getInt();
+    syncSeed = generationRandom.getInt();
 
     double p = 0;
     if (maxObjects > 0)
@@ -195,46 +321,131 @@ void Builder::recurseBreadthFirst(
 
     // Now iterate though all RuleState's on stack and create next generation.
     //INFO(QString("Executing generation %1 with %2 individuals").arg(generationCounter).arg(stack.size()));
+    // (nextStack is empty here, but keeps the capacity of an earlier generation.)
+    // A 'set' action changes the builder for the states executed after it, which the
+    // workers would not see: such generations are executed serially.
+    if (threadCount > 0
+        && std::none_of(
+            stack.begin(),
+            stack.end(),
+            [&](const RuleState& s) { return program->runsSetActions(s.rule); }))
+    {
+      executeGenerationInParallel(syncSeed, maxTerminated, minTerminated);
+    }
+    else
+    {
+      executeStates(stack, 0, stack.size(), syncSeed, maxTerminated, minTerminated);
+    }
+    // Swap the generation buffers, the states of the executed generation are
+    // released without giving their storage back to the allocator.
+    stack.swap(nextStack);
     nextStack.clear();
-    for (int i = 0; i < stack.size(); i++)
+  }
+}
+
+void Builder::executeStates(
+    ExecutionStack& states,
+    int begin,
+    int end,
+    int syncSeed,
+    int& maxTerminated,
+    int& minTerminated)
+{
+  for (int i = begin; i < end; i++)
+  {
+    //	INFO("Executing: " + states[i].rule->getName());
+    currentState = &states[i].state;
+    if (currentState->seed != 0)
     {
-      //	INFO("Executing: " + stack[i].rule->getName());
-      currentState = &stack[i].state;
-      if (currentState->seed != 0)
-      {
-        RandomStreams::SetSeed(currentState->seed);
-        currentState->seed = RandomStreams::Geometry()->getInt();
-      }
-      state = stack[i].state;
+      currentState->random.setSeed(currentState->seed);
+      currentState->seed = currentState->random.Geometry().getInt();
+    }
+    state = states[i].state;
 
-      // if we are synchronizing random numbers every state must get the same rands
-      if (syncRandom)
+    // if we are synchronizing random numbers every state must get the same rands
+    if (syncRandom)
+    {
+      state.random.setSeed(syncSeed);
+    }
+
+    // Check the dimensions against the min and max limits.
+    if (maxDim != 0 || minDim != 0)
+    {
+      Vector3f s = state.matrix * Vector3f(1, 1, 1) - state.matrix * Vector3f(0, 0, 0);
+      double l = s.length();
+      if (maxDim && l > maxDim)
       {
-        RandomStreams::SetSeed(syncSeed);
+        maxTerminated++;
+        continue;
       }
-
-      // Check the dimensions against the min and max limits.
-      if (maxDim != 0 || minDim != 0)
+      if (minDim && l < minDim)
       {
-        Vector3f s = state.matrix * Vector3f(1, 1, 1) - state.matrix * Vector3f(0, 0, 0);
-        double l = s.length();
-        if (maxDim && l > maxDim)
-        {
-          maxTerminated++;
-          continue;
-        }
-        if (minDim && l < minDim)
-        {
-          minTerminated++;
-          continue;
-        }
+        minTerminated++;
+        continue;
       }
-
-      Q_ASSERT(stack.size() > i);
-      Q_ASSERT(stack[i].rule);
-      stack[i].rule->apply(this);
     }
-    stack = nextStack;
+
+    Q_ASSERT(states.size() > i);
+    program->execute(this, states[i].rule);
+  }
+}
+
+void Builder::executeGenerationInParallel(
+    int syncSeed,
+    int& maxTerminated,
+    int& minTerminated)
+{
+  if (!threadPool || threadPool->size() != threadCount)
+  {
+    threadPool = std::make_unique<Misc::ThreadPool>(threadCount);
+  }
+
+  // Split the stack into contiguous chunks (a few per thread, for load balancing).
+  // Every chunk is executed by its own worker, and the results are merged in
+  // the original stack order afterwards.
+  const int count = stack.size();
+  const int chunks = std::clamp(count / minimumChunkSize, 1, threadPool->size() * 4);
+
+  std::vector<std::unique_ptr<Builder>> workers(chunks);
+  if ((int)workerStacks.size() < chunks)
+    workerStacks.resize(chunks);
+  std::vector<Rendering::RecordingRenderer> sinks(
+      chunks, Rendering::RecordingRenderer(renderTarget));
+  std::vector<int> maxTerminatedCounts(chunks, 0);
+  std::vector<int> minTerminatedCounts(chunks, 0);
+
+  threadPool->run(
+      chunks,
+      [&](int chunk)
+      {
+        const int begin = int((int64_t)count * chunk / chunks);
+        const int end = int((int64_t)count * (chunk + 1) / chunks);
+        workers[chunk].reset(new Builder(*this, &sinks[chunk]));
+        workers[chunk]->nextStack.swap(workerStacks[chunk]);
+        workers[chunk]->executeStates(
+            stack,
+            begin,
+            end,
+            syncSeed,
+            maxTerminatedCounts[chunk],
+            minTerminatedCounts[chunk]);
+        workers[chunk]->flushPrimitives();
+      });
+
+  flushPrimitives();
+  for (int chunk = 0; chunk < chunks; chunk++)
+  {
+    Builder& worker = *workers[chunk];
+    sinks[chunk].replay(renderTarget);
+    nextStack.insert(
+        nextStack.end(),
+        std::make_move_iterator(worker.nextStack.begin()),
+        std::make_move_iterator(worker.nextStack.end()));
+    worker.nextStack.clear();
+    worker.nextStack.swap(workerStacks[chunk]);
+    objects += worker.objects;
+    maxTerminated += maxTerminatedCounts[chunk];
+    minTerminated += minTerminatedCounts[chunk];
   }
 }
 
@@ -244,8 +455,17 @@ void Builder::build()
   if (verbose)
     INFO("Starting builder...");
 
+  trackPreviousState = ruleSet->isMeshReachable();
+  program = std::make_shared<RuleProgram>(*ruleSet);
+
   /// Push first generation state
-  stack.push_back(RuleState(ruleSet->getStartRule(), State()));
+  State start;
+  start.random.setSeed(rootSeed);
+  generationRandom = start.random.Geometry().derive(syncStream);
+  initialSeed = generationRandom.derive(0).getInt();
+  if (initialSeed == 0)
+    initialSeed = 1;
+  stack.push_back(RuleState(RuleProgram::StartRule, start));
   int generationCounter = 0;
 
   ProgressDialog progressDialog("Building objects...", "Cancel", 0, 100, 0);
@@ -273,6 +493,7 @@ void Builder::build()
     recurseBreadthFirst(progressDialog, maxTerminated, minTerminated, generationCounter);
   }
 
+  flushPrimitives();
   progressDialog.setValue(100);
   progressDialog.hide();
 
@@ -326,6 +547,9 @@ void Builder::build()
 
 void Builder::setCommand(const QString& command, QString param)
 {
+  // The renderer must receive the primitives drawn before the command first.
+  flushPrimitives();
+
   if (command.toLower().startsWith("raytracer::"))
   {
     const QString& c = command.toLower().remove("raytracer::");
@@ -407,15 +631,27 @@ void Builder::setCommand(const QString& command, QString param)
       if (maxGenerations > 0)
       {
         ruleSet->setRulesMaxDepth(maxGenerations);
+        if (program)
+          program->updateMaxDepths();
       }
     }
   }
   else if (command == "colorpool")
   {
-    delete colorPool;
     colorPool
         = nullptr; // Important - prevents crash if ColorPool constructor throws exception
-    colorPool = new ColorPool(param); // will throw exception for invalid pools.
+    // will throw exception for invalid pools.
+    colorPool = std::make_shared<ColorPool>(param);
+  }
+  else if (command == "threads")
+  {
+    bool succes = 0;
+    int i = param.toInt(&succes);
+    if (!succes || i < 0)
+      throw Exception(
+          QString("Command 'threads' expected a non-negative integer. Found: %1")
+              .arg(param));
+    threadCount = i;
   }
   else if (command == "recursion")
   {
@@ -489,12 +725,8 @@ void Builder::setCommand(const QString& command, QString param)
 
     if (param.toLower() == "initial")
     {
-      if (initialSeed == 0)
-      {
-        initialSeed = RandomStreams::Geometry()->getInt();
-      }
       currentState->seed = initialSeed;
-      state.seed = initialSeed;
+      activeState->seed = initialSeed;
     }
     else
     {
@@ -504,7 +736,8 @@ void Builder::setCommand(const QString& command, QString param)
         throw Exception(
             QString("Command 'seed' expected integer parameter or 'initial'. Found: %1")
                 .arg(param));
-      RandomStreams::SetSeed(i);
+      activeState->random.setSeed(i);
+      generationRandom = activeState->random.Geometry().derive(syncStream);
       hasSeedChanged = true;
       newSeed = i;
     }
@@ -594,7 +827,6 @@ Builder::~Builder()
 {
   //delete(ruleSet);
   //delete(currentState);
-  delete (colorPool);
 }
 }
 }
@@ -5,8 +5,13 @@
 #include <ssynth/ColorPool.h>
 #include <ssynth/Model/ExecutionStack.h>
 #include <ssynth/Model/Rendering/Renderer.h>
+#include <ssynth/Model/RuleProgram.h>
 #include <ssynth/Model/RuleSet.h>
 #include <ssynth/Model/State.h>
+#include <ssynth/RandomStreams.h>
+#include <ssynth/ThreadPool.h>
+
+#include <memory>
 
 // #include <ssynth/Matrix4.h>
 // #include <ssynth/GLEngine/EngineWidget.h>
@@ -37,18 +42,56 @@ public:
 
   void setCommand(const QString& command, QString param);
   ExecutionStack& getNextStack();
-  State& getState() { return state; };
+  State& getState() { return *activeState; };
   Rendering::Renderer* getRenderer() { return renderTarget; };
   void increaseObjectCount() { objects++; };
 
+  /// Adds a primitive, with the color of the current state, to the batch sent to the
+  /// renderer. The caller sets its matrix (and its MeshRecord, see 'addMeshStart').
+  Rendering::PrimitiveRecord&
+  addPrimitive(Rendering::PrimitiveRecord::Type type, PrimitiveClass* classID);
+  /// Adds the MeshRecord of mesh 'p', which must be the last added primitive.
+  Rendering::MeshRecord& addMeshStart(Rendering::PrimitiveRecord& p);
+  /// Sends the batched primitives to the renderer.
+  void flushPrimitives();
+
   // True, if the random seed was changed by the builder (by 'set seed <int>')
   bool seedChanged() { return hasSeedChanged; }
   int getNewSeed() { return newSeed; }
-  ColorPool* getColorPool() { return colorPool; }
+  ColorPool* getColorPool() { return colorPool.get(); }
+  /// True if new states must remember their parent state (see State::previous).
+  bool tracksPreviousState() const { return trackPreviousState; }
   // std::vector<GLEngine::Command> getRaytracerCommands() { return raytracerCommands; };
   bool wasCancelled() { return userCancelled; }
 
+  /// Sets the number of threads used for executing breadth-first generations
+  /// (also available as 'set threads <int>').
+  ///
+  /// 0 (the default) executes each generation serially, any other value enables the
+  /// parallel generation executor. Since every state carries its own random streams,
+  /// the output does not depend on the thread count.
+  void setThreadCount(int threads) { threadCount = threads; }
+  int getThreadCount() const { return threadCount; }
+
+  /// Sets the seed of the random streams of the start rule (default 0).
+  void setSeed(int seed) { rootSeed = seed; }
+
+
 private:
+  /// Constructs a worker for the parallel generation executor.
+  /// It shares the rule set and settings of 'parent', but renders into 'sink'.
+  Builder(const Builder& parent, Rendering::Renderer* sink);
+
+  /// Executes the states in 'states[begin;end)', their children are added to nextStack.
+  void executeStates(
+      ExecutionStack& states,
+      int begin,
+      int end,
+      int syncSeed,
+      int& maxTerminated,
+      int& minTerminated);
+  void executeGenerationInParallel(int syncSeed, int& maxTerminated, int& minTerminated);
+
   void recurseBreadthFirst(
       ProgressDialog& progressDialog,
       int& maxTerminated,
@@ -60,13 +103,34 @@ private:
       int& minTerminated,
       int& generationCounter);
 
+  /// A custom rule whose actions are being expanded by the depth-first traversal.
+  struct DepthFirstFrame
+  {
+    State state; // The state the rule is executed in.
+    int rule{-1};
+    int depthId{-1}; // See RuleProgram::depthTrackingId
+    int depth{};
+    int action{};
+    RuleProgram::Cursor cursor;
+    // The children of a rule reaching 'set' actions, which are created up front (see
+    // 'recurseDepthFirst'), and the next one to execute.
+    std::vector<RuleState> expanded;
+    int nextExpanded{};
+  };
+
   State state;
+  State* activeState{&state}; // The executing state ('state' or a depth-first frame)
 
   bool userCancelled;
 
+  // The current and the next generation. They are swapped after each generation,
+  // so their storage is reused for the following generations.
   ExecutionStack stack;
   ExecutionStack nextStack;
+  std::vector<ExecutionStack> workerStacks; // Reused 'nextStack' of parallel workers.
   Rendering::Renderer* renderTarget;
+  std::vector<Rendering::PrimitiveRecord> primitives; // Not yet sent to renderTarget.
+  std::vector<Rendering::MeshRecord> meshes;           // The starts of their meshes.
   RuleSet* ruleSet;
   bool verbose;
   int maxGenerations;
@@ -77,9 +141,17 @@ private:
   float minDim;
   float maxDim;
   bool syncRandom;
+  bool trackPreviousState{true};
+  Math::CounterRandomGenerator generationRandom; // Seeds for 'set syncrandom'.
   int initialSeed;
+  int rootSeed{0};
   State* currentState{};
-  ColorPool* colorPool{};
+  std::shared_ptr<ColorPool> colorPool;
+  std::shared_ptr<RuleProgram> program; // Compiled from 'ruleSet' by 'build'.
+
+  // Parallel generation executor
+  int threadCount{0};
+  std::unique_ptr<Misc::ThreadPool> threadPool;
   // std::vector<GLEngine::Command> raytracerCommands;
 };
 
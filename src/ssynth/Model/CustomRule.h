@@ -17,17 +17,19 @@ public:
   CustomRule(const QString& name);
   virtual ~CustomRule();
 
-  virtual void apply(Builder* builder) const;
-
   /// Returns a list over rules that this rule references.
   virtual std::vector<RuleRef*> getRuleRefs() const;
 
   void appendAction(Action a) { actions.push_back(a); }
+  const std::vector<Action>& getActions() const { return actions; }
+  std::vector<Action>& getActions() { return actions; }
 
   double getWeight() const { return weight; }
   void setWeight(double w) { weight = w; }
 
   void setRetirementRule(QString ruleName) { retirementRule = new RuleRef(ruleName); };
+  /// The rule applied instead of this rule when it reaches its max. depth (or nullptr).
+  RuleRef* getRetirementRule() const { return retirementRule; }
 
 private:
   std::vector<Action> actions;
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+
+/// The max. recursion depths of the rules in a State.
+///
+/// Rules are identified by the dense ids assigned by RuleSet::resolveNames
+/// (see Rule::getDepthId). The first 'InlineSize' ids are stored in place, so for most
+/// rule sets copying a table is a plain memcpy. Larger ids are stored in a block shared
+/// between copies, which is only duplicated when a shared block is written to.
+class DepthTable
+{
+public:
+  /// Returned by 'get' for rules without a stored depth.
+  static constexpr int Unset = INT_MIN;
+  static constexpr int InlineSize = 8;
+
+  DepthTable() { std::fill_n(depths, InlineSize, Unset); }
+
+  int get(int id) const
+  {
+    if (id < InlineSize)
+      return depths[id];
+    id -= InlineSize;
+    return (overflow && id < (int)overflow->size()) ? (*overflow)[id] : Unset;
+  }
+
+  void set(int id, int depth)
+  {
+    if (id < InlineSize)
+    {
+      depths[id] = depth;
+      return;
+    }
+    id -= InlineSize;
+    if (!overflow)
+      overflow = std::make_shared<std::vector<int>>();
+    else if (overflow.use_count() > 1)
+      overflow = std::make_shared<std::vector<int>>(*overflow);
+    if ((int)overflow->size() <= id)
+      overflow->resize(id + 1, Unset);
+    (*overflow)[id] = depth;
+  }
+
+private:
+  int depths[InlineSize];
+  std::shared_ptr<std::vector<int>> overflow;
+};
+
+}
+}
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <ssynth/Model/Rule.h>
 #include <ssynth/Model/State.h>
 
+#include <utility>
+
 namespace ssynth
 {
 namespace Model
@@ -11,14 +12,14 @@ namespace Model
 struct RuleState
 {
   RuleState(){};
-  RuleState(Rule* rule, State state)
+  RuleState(int rule, State state)
       : rule(rule)
-      , state(state)
+      , state(std::move(state))
   {
-    Q_ASSERT(rule);
+    Q_ASSERT(rule >= 0);
   };
 
-  Rule* rule{};
+  int rule{-1}; // The index of the rule in the RuleProgram.
   State state;
 };
 
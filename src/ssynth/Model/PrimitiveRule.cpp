@@ -64,85 +64,63 @@ PrimitiveRule::PrimitiveRule(PrimitiveType type, PrimitiveClass* primitiveClass)
 
 void PrimitiveRule::apply(Builder* b) const
 {
+  using Rendering::PrimitiveRecord;
+
   if (type == Template)
   {
-    b->getRenderer()->callGeneric(primitiveClass);
+    b->addPrimitive(PrimitiveRecord::Generic, primitiveClass);
     return;
   }
 
   b->increaseObjectCount();
-  b->getRenderer()->setColor(Misc::ColorUtils::HSVtoRGB(b->getState().hsv));
-
-  b->getRenderer()->setAlpha(b->getState().alpha);
-
-  if (type == Sphere)
-  {
-    Vector3f v(0, 0, 0);
-    // Vector3f v1 = b->getState().matrix * v;
-    Vector3f c = b->getState().matrix * Vector3f(0.5, 0.5, 0.5);
-    Vector3f c2 = (b->getState().matrix * Vector3f(0.5, 0.5, 0.0));
-    double r = (c - c2).length();
-
-    b->getRenderer()->drawSphere(c, r, primitiveClass);
-  }
-  else if (type == Mesh)
-  {
-    if (b->getState().previous)
-    {
-
-      Vector3f v1 = (b->getState().previous->matrix) * Vector3f(0, 0, 0);
-      Vector3f v2 = (b->getState().previous->matrix) * Vector3f(1, 0, 0);
-      Vector3f v3 = (b->getState().previous->matrix) * Vector3f(0, 1, 0);
-
-      Vector3f u1 = b->getState().matrix * Vector3f(0, 0, 0);
-      Vector3f u2 = b->getState().matrix * Vector3f(1, 0, 0);
-      Vector3f u3 = b->getState().matrix * Vector3f(0, 1, 0);
-      b->getRenderer()->setPreviousColor(
-          Misc::ColorUtils::HSVtoRGB(b->getState().previous->hsv));
-      b->getRenderer()->setPreviousAlpha(b->getState().previous->alpha);
-
-      b->getRenderer()->drawMesh(
-          v1, v2 - v1, v3 - v1, u1, u2 - u1, u3 - u1, primitiveClass);
-    }
-    else
-    {
-      INFO("No prev");
-    }
-  }
-  else if (type == Box)
-  {
-    Vector3f v(0, 0, 0);
-
-    Vector3f v1 = b->getState().matrix * v;
-    Vector3f v2 = b->getState().matrix * Vector3f(1, 0, 0);
-    Vector3f v3 = b->getState().matrix * Vector3f(0, 1, 0);
-    Vector3f v4 = b->getState().matrix * Vector3f(0, 0, 1);
 
-    b->getRenderer()->drawBox(v1, v2 - v1, v3 - v1, v4 - v1, primitiveClass);
+  PrimitiveRecord::Type recordType;
+  switch (type)
+  {
+    case Box:
+      recordType = PrimitiveRecord::Box;
+      break;
+    case Sphere:
+      recordType = PrimitiveRecord::Sphere;
+      break;
+    case Dot:
+      recordType = PrimitiveRecord::Dot;
+      break;
+    case Grid:
+      recordType = PrimitiveRecord::Grid;
+      break;
+    case Line:
+      recordType = PrimitiveRecord::Line;
+      break;
+    case Mesh:
+      recordType = PrimitiveRecord::Mesh;
+      break;
+    default:
+      // Cylinders and other types are not drawn, but still set the color.
+      b->addPrimitive(PrimitiveRecord::Color, primitiveClass);
+      return;
+  }
+
+  const auto& previous = b->getState().previous;
+  if (type == Mesh && !previous)
+  {
+    b->addPrimitive(PrimitiveRecord::Color, primitiveClass);
+    INFO("No prev");
+    return;
   }
-  else if (type == Grid)
-  {
-    Vector3f v(0, 0, 0);
-
-    Vector3f v1 = b->getState().matrix * v;
-    Vector3f v2 = b->getState().matrix * Vector3f(1, 0, 0);
-    Vector3f v3 = b->getState().matrix * Vector3f(0, 1, 0);
-    Vector3f v4 = b->getState().matrix * Vector3f(0, 0, 1);
 
-    b->getRenderer()->drawGrid(v1, v2 - v1, v3 - v1, v4 - v1, primitiveClass);
-  }
-  else if (type == Dot)
+  // The renderer derives the geometry from the matrix (see PrimitiveRecord).
+  PrimitiveRecord& p = b->addPrimitive(recordType, primitiveClass);
+  p.matrix = b->getState().matrix;
+  if (type == Mesh)
   {
-    Vector3f v = b->getState().matrix * Vector3f(0.5, 0.5, 0.5);
-
-    b->getRenderer()->drawDot(v, primitiveClass);
-  }
-  else if (type == Line)
-  {
-    Vector3f v = b->getState().matrix * Vector3f(0, 0.5, 0.5);
-    Vector3f v2 = b->getState().matrix * Vector3f(1, 0.5, 0.5);
-
-    b->getRenderer()->drawLine(v, v2, primitiveClass);
+    Rendering::MeshRecord& start = b->addMeshStart(p);
+    start.matrix = previous->matrix;
+    const Vector3f rgb = Misc::ColorUtils::HSVtoRGB(previous->hsv);
+    start.rgba[0] = rgb.x();
+    start.rgba[1] = rgb.y();
+    start.rgba[2] = rgb.z();
+    start.rgba[3] = previous->alpha;
   }
 };
 
@@ -162,15 +140,11 @@ TriangleRule::TriangleRule(
 void TriangleRule::apply(Builder* b) const
 {
   b->increaseObjectCount();
-  b->getRenderer()->setColor(Misc::ColorUtils::HSVtoRGB(b->getState().hsv));
-
-  b->getRenderer()->setAlpha(b->getState().alpha);
-
-  Vector3f v1 = b->getState().matrix * p1;
-  Vector3f v2 = b->getState().matrix * p2;
-  Vector3f v3 = b->getState().matrix * p3;
 
-  b->getRenderer()->drawTriangle(v1, v2, v3, primitiveClass);
+  const AffineMatrix4f& m = b->getState().matrix;
+  Rendering::PrimitiveRecord& p
+      = b->addPrimitive(Rendering::PrimitiveRecord::Triangle, primitiveClass);
+  p.matrix = AffineMatrix4f::FromColumns(m * p2, m * p3, Vector3f(), m * p1);
 }
 
 }
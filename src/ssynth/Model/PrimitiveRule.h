@@ -8,6 +8,8 @@ namespace ssynth
 namespace Model
 {
 
+class Builder; // forward decl.
+
 /// These are the built-in primitives,
 /// for drawing boxes, spheres and other simple geometric shapes.
 class PrimitiveRule : public Rule
@@ -27,6 +29,8 @@ public:
   };
 
   PrimitiveRule(PrimitiveType type, PrimitiveClass* primitiveClass);
+
+  /// Draws the primitive in the current state of the builder.
   virtual void apply(Builder* builder) const;
 
   /// Returns a list over rules that this rule references.
@@ -44,6 +48,8 @@ public:
   }
   PrimitiveClass* getClass() { return primitiveClass; }
 
+  PrimitiveType getType() const { return type; }
+
 protected:
   PrimitiveClass* primitiveClass;
 
@@ -64,6 +70,8 @@ public:
   virtual void apply(Builder* builder) const;
 
 private:
+  friend class RuleSetCache;
+
   Math::Vector3f p1;
   Math::Vector3f p2;
   Math::Vector3f p3;
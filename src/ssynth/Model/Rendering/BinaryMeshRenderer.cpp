@@ -0,0 +1,125 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Logging.h>
+#include <ssynth/Model/Rendering/BinaryMeshRenderer.h>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Logging;
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+BinaryMeshRenderer::BinaryMeshRenderer(
+    const QString& fileName,
+    int sphereDT,
+    int sphereDP,
+    bool groupByTagging,
+    bool groupByColor)
+    : ObjRenderer(sphereDT, sphereDP, groupByTagging, groupByColor)
+    , fileName(fileName)
+{
+}
+
+BinaryMeshRenderer::~BinaryMeshRenderer()
+{
+  if (file)
+    fclose(file);
+}
+
+void BinaryMeshRenderer::begin()
+{
+  ObjRenderer::begin();
+
+  file = fopen(fileName.toLocal8Bit().data(), "wb");
+  if (!file)
+    throw Exception(QString("Unable to open file for writing: %1").arg(fileName));
+  fileBuffer.resize(1 << 20);
+  setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+  groupNames.clear();
+  groupIndices.clear();
+  lastGroup.clear();
+  lastGroupIndex = -1;
+  skippedPrimitives = false;
+  writeHeader();
+}
+
+void BinaryMeshRenderer::end()
+{
+  if (!file)
+    return;
+  writeFooter();
+  const bool failed = fflush(file) != 0 || ferror(file);
+  fclose(file);
+  file = nullptr;
+  if (failed)
+    throw Exception(QString("Unable to write file: %1").arg(fileName));
+
+  if (skippedPrimitives)
+    WARNING("Lines, dots and grids were not written (they have no triangles).");
+}
+
+void BinaryMeshRenderer::put(std::FILE* f, const void* data, std::size_t size)
+{
+  if (fwrite(data, 1, size, f) != size)
+    throw Exception(QString("Unable to write file: %1").arg(fileName));
+}
+
+auto BinaryMeshRenderer::groupIndex() -> int
+{
+  // Consecutive primitives are usually in the same group.
+  if (lastGroupIndex == -1 || currentGroup != lastGroup)
+  {
+    auto [it, inserted] = groupIndices.try_emplace(currentGroup, (int)groupNames.size());
+    if (inserted)
+      groupNames.push_back(currentGroup);
+    lastGroup = currentGroup;
+    lastGroupIndex = it->second;
+  }
+  return lastGroupIndex;
+}
+
+void BinaryMeshRenderer::emitPrimitive(const ObjGroup& primitive)
+{
+  if (!file)
+    throw Exception("The renderer must be started (by 'begin') before drawing.");
+
+  // The faces are split into triangle fans.
+  triangles.clear();
+  for (const std::vector<VertexNormal>& face : primitive.faces)
+  {
+    if (face.size() < 3)
+    {
+      skippedPrimitives = true;
+      continue;
+    }
+    for (int i = 2; i < face.size(); i++)
+    {
+      triangles.push_back(Triangle{
+          uint32_t(face[0].vID - 1),
+          uint32_t(face[i - 1].vID - 1),
+          uint32_t(face[i].vID - 1)});
+    }
+  }
+  if (!triangles.empty())
+    writePrimitive(primitive.vertices, triangles, groupIndex());
+}
+
+void BinaryMeshRenderer::addPrimitive(ObjGroup& primitive)
+{
+  emitPrimitive(primitive);
+}
+
+void BinaryMeshRenderer::addInstance(const ObjGroup& mesh, const AffineMatrix4f& m)
+{
+  instance.vertices.clear();
+  instance.normals.clear();
+  instance.faces.clear();
+  instance.addGroup(mesh, m);
+  emitPrimitive(instance);
+}
+
+}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/ObjRenderer.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// Base class for the renderers writing binary triangle meshes (see PlyRenderer and
+/// StlRenderer).
+///
+/// The primitives are tessellated as by the ObjRenderer, and grouped the same way
+/// (by tag and/or color), but every primitive is written to the file as soon as it is
+/// drawn. The file is opened by 'begin' and completed by 'end'.
+/// Lines, dots and grids have no triangles, and are skipped.
+class BinaryMeshRenderer : public ObjRenderer
+{
+public:
+  using Triangle = std::array<uint32_t, 3>;
+
+  BinaryMeshRenderer(
+      const QString& fileName,
+      int sphereDT,
+      int sphereDP,
+      bool groupByTagging,
+      bool groupByColor);
+  virtual ~BinaryMeshRenderer();
+
+  virtual void begin();
+  virtual void end();
+
+protected:
+  virtual void addPrimitive(ObjGroup& primitive);
+  virtual void addInstance(const ObjGroup& mesh, const Math::AffineMatrix4f& m);
+
+  /// Writes the start of the file.
+  virtual void writeHeader() = 0;
+  /// Writes a primitive, whose 'triangles' index (from 0) its 'vertices'.
+  virtual void writePrimitive(
+      const std::vector<Math::Vector3f>& vertices,
+      const std::vector<Triangle>& triangles,
+      int group)
+      = 0;
+  /// Completes the file.
+  virtual void writeFooter() = 0;
+
+  /// The names of the groups, indexed by the group numbers given to 'writePrimitive'.
+  std::vector<QString> groupNames;
+
+  /// Appends 'value' to 'out' in little-endian byte order.
+  template <typename T>
+  static void append(std::vector<char>& out, T value)
+  {
+    auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+    if constexpr (std::endian::native == std::endian::big)
+      std::reverse(bytes.begin(), bytes.end());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+  }
+
+  /// Writes to 'f' (which is 'file' or a temporary file).
+  void put(std::FILE* f, const void* data, std::size_t size);
+  void put(std::FILE* f, const std::vector<char>& data)
+  {
+    put(f, data.data(), data.size());
+  }
+
+  std::FILE* file{};
+
+private:
+  int groupIndex();
+  void emitPrimitive(const ObjGroup& primitive);
+
+  QString fileName;
+  std::vector<char> fileBuffer;
+  std::vector<Triangle> triangles;
+  ObjGroup instance;
+  std::map<QString, int> groupIndices;
+  QString lastGroup;
+  int lastGroupIndex{-1};
+  bool skippedPrimitives{false};
+};
+
+}
+}
+}
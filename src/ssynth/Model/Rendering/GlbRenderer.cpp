@@ -0,0 +1,806 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Model/Rendering/GlbRenderer.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <string>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+namespace
+{
+// glTF constants
+constexpr int Float = 5126;
+constexpr int UnsignedInt = 5125;
+constexpr int UnsignedByte = 5121;
+constexpr int ArrayBuffer = 34962;
+constexpr int ElementArrayBuffer = 34963;
+constexpr int Points = 0;
+constexpr int Lines = 1;
+constexpr int Triangles = 4;
+
+Vector3f vertex(const GlbRenderer::Geometry& g, uint32_t index)
+{
+  return Vector3f(
+      g.positions[3 * index], g.positions[3 * index + 1], g.positions[3 * index + 2]);
+}
+
+void addVertex(GlbRenderer::Geometry& g, Vector3f v)
+{
+  g.positions.insert(g.positions.end(), {v.x(), v.y(), v.z()});
+}
+
+/// Adds a triangle facing away from 'inside'.
+void addTriangle(
+    GlbRenderer::Geometry& g,
+    uint32_t a,
+    uint32_t b,
+    uint32_t c,
+    Vector3f inside)
+{
+  const Vector3f pa = vertex(g, a);
+  const Vector3f normal = Vector3f::cross(vertex(g, b) - pa, vertex(g, c) - pa);
+  const Vector3f outwards = (pa + vertex(g, b) + vertex(g, c)) * (1.0f / 3) - inside;
+  if (Vector3f::dot(normal, outwards) < 0)
+    std::swap(b, c);
+  g.indices.insert(g.indices.end(), {a, b, c});
+}
+
+/// The unit cube [0;1]^3: vertex 'x + 2y + 4z' is at (x, y, z).
+void createCubeVertices(GlbRenderer::Geometry& g)
+{
+  for (int i = 0; i < 8; i++)
+    addVertex(g, Vector3f(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+}
+
+auto createBox() -> GlbRenderer::Geometry
+{
+  GlbRenderer::Geometry g;
+  createCubeVertices(g);
+  const Vector3f center(0.5, 0.5, 0.5);
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const int bit = 1 << axis;
+    const int u = 1 << ((axis + 1) % 3);
+    const int v = 1 << ((axis + 2) % 3);
+    for (int side : {0, bit})
+    {
+      addTriangle(g, side, side + u, side + u + v, center);
+      addTriangle(g, side, side + u + v, side + v, center);
+    }
+  }
+  return g;
+}
+
+auto createGrid() -> GlbRenderer::Geometry
+{
+  // The twelve edges of the unit cube.
+  GlbRenderer::Geometry g;
+  createCubeVertices(g);
+  for (uint32_t i = 0; i < 8; i++)
+  {
+    for (uint32_t bit : {1, 2, 4})
+    {
+      if (!(i & bit))
+        g.indices.insert(g.indices.end(), {i, i | bit});
+    }
+  }
+  return g;
+}
+
+auto createSphere(int dt, int dp) -> GlbRenderer::Geometry
+{
+  // Rings of 'dp' vertices from the south pole to the north pole.
+  GlbRenderer::Geometry g;
+  dt = std::max(dt, 2);
+  dp = std::max(dp, 3);
+  for (int i = 0; i <= dt; i++)
+  {
+    const double theta = std::numbers::pi * (-0.5 + double(i) / dt);
+    for (int j = 0; j < dp; j++)
+    {
+      const double phi = 2 * std::numbers::pi * j / dp;
+      addVertex(
+          g,
+          Vector3f(cos(theta) * cos(phi), cos(theta) * sin(phi), sin(theta)));
+    }
+  }
+  for (int i = 0; i < dt; i++)
+  {
+    for (int j = 0; j < dp; j++)
+    {
+      const uint32_t a = i * dp + j;
+      const uint32_t b = i * dp + (j + 1) % dp;
+      const uint32_t c = b + dp;
+      const uint32_t d = a + dp;
+      // The first and last rings are single points.
+      if (i != 0)
+        addTriangle(g, a, b, c, Vector3f());
+      if (i != dt - 1)
+        addTriangle(g, a, c, d, Vector3f());
+    }
+  }
+  return g;
+}
+
+void appendNumber(std::string& out, double value)
+{
+  char buffer[32];
+  out.append(buffer, std::to_chars(buffer, buffer + 32, float(value)).ptr);
+}
+
+void appendString(std::string& out, const QString& s)
+{
+  out += '"';
+  for (char c : s.toUtf8())
+  {
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if ((unsigned char)c < 0x20)
+    {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out += buffer;
+    }
+    else
+    {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+/// The JSON and binary chunks of a GLB file.
+class GlbDocument
+{
+public:
+  /// Adds a buffer view of 'size' bytes at 'data' (which must be valid until 'write'),
+  /// made of 'elementSize' byte numbers. Returns its index.
+  int addView(const void* data, std::size_t size, int elementSize, int target)
+  {
+    std::string& out = next(views);
+    out += "{\"buffer\":0,\"byteOffset\":" + std::to_string(binarySize)
+           + ",\"byteLength\":" + std::to_string(size);
+    if (target)
+      out += ",\"target\":" + std::to_string(target);
+    out += '}';
+    chunks.push_back(Chunk{(const char*)data, size, elementSize});
+    binarySize += (size + 3) & ~std::size_t(3);
+    return viewCount++;
+  }
+
+  /// Adds an accessor and returns its index.
+  int addAccessor(
+      int view,
+      int componentType,
+      std::size_t count,
+      const char* type,
+      bool normalized = false,
+      const std::string& bounds = {})
+  {
+    std::string& out = next(accessors);
+    out += "{\"bufferView\":" + std::to_string(view)
+           + ",\"componentType\":" + std::to_string(componentType)
+           + ",\"count\":" + std::to_string(count) + ",\"type\":\"" + type + '"';
+    if (normalized)
+      out += ",\"normalized\":true";
+    out += bounds + '}';
+    return accessorCount++;
+  }
+
+  /// Adds the positions (with their bounds, as required by glTF).
+  int addPositions(const std::vector<float>& positions)
+  {
+    float min[3] = {INFINITY, INFINITY, INFINITY};
+    float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (std::size_t i = 0; i < positions.size(); i++)
+    {
+      min[i % 3] = std::min(min[i % 3], positions[i]);
+      max[i % 3] = std::max(max[i % 3], positions[i]);
+    }
+    std::string bounds;
+    for (auto [name, values] : {std::pair{",\"min\":[", min}, std::pair{",\"max\":[", max}})
+    {
+      bounds += name;
+      for (int i = 0; i < 3; i++)
+      {
+        if (i)
+          bounds += ',';
+        appendNumber(bounds, values[i]);
+      }
+      bounds += ']';
+    }
+    const int view = addView(positions.data(), 4 * positions.size(), 4, ArrayBuffer);
+    return addAccessor(view, Float, positions.size() / 3, "VEC3", false, bounds);
+  }
+
+  int addFloats(const std::vector<float>& values, int components, const char* type)
+  {
+    const int view = addView(values.data(), 4 * values.size(), 4, 0);
+    return addAccessor(view, Float, values.size() / components, type);
+  }
+
+  int addColors(const std::vector<uint8_t>& colors, int target)
+  {
+    const int view = addView(colors.data(), colors.size(), 1, target);
+    return addAccessor(view, UnsignedByte, colors.size() / 4, "VEC4", true);
+  }
+
+  int addIndices(const std::vector<uint32_t>& indices)
+  {
+    const int view = addView(indices.data(), 4 * indices.size(), 4, ElementArrayBuffer);
+    return addAccessor(view, UnsignedInt, indices.size(), "SCALAR");
+  }
+
+  /// Adds a mesh with a single primitive, drawn by a node. Returns the node.
+  std::string&
+  addMesh(const QString& name, const std::string& attributes, int indices, int mode)
+  {
+    std::string& mesh = next(meshes);
+    mesh += "{\"name\":";
+    appendString(mesh, name);
+    mesh += ",\"primitives\":[{\"attributes\":{" + attributes
+            + "},\"indices\":" + std::to_string(indices)
+            + ",\"mode\":" + std::to_string(mode) + ",\"material\":0}]}";
+
+    std::string& node = next(nodes);
+    node += "{\"mesh\":" + std::to_string(meshCount++);
+    nodeCount++;
+    return node; // Closed by 'json'.
+  }
+
+  std::string json(bool transparent, bool instancing) const
+  {
+    std::string out = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Structure Synth\"}";
+    if (instancing)
+    {
+      out += ",\"extensionsUsed\":[\"EXT_mesh_gpu_instancing\"]"
+             ",\"extensionsRequired\":[\"EXT_mesh_gpu_instancing\"]";
+    }
+    // Empty arrays are not valid glTF, so an empty scene has no nodes at all.
+    if (nodeCount)
+    {
+      out += ",\"scene\":0,\"scenes\":[{\"nodes\":[";
+      for (int i = 0; i < nodeCount; i++)
+        out += (i ? "," : "") + std::to_string(i);
+      out += "]}]";
+      out += ",\"nodes\":[" + nodes + "]";
+    }
+    else
+    {
+      out += ",\"scene\":0,\"scenes\":[{}]";
+    }
+    if (meshCount)
+    {
+      out += ",\"meshes\":[" + meshes + "]";
+      out += ",\"materials\":[{\"name\":\"default\",\"pbrMetallicRoughness\":{"
+             "\"baseColorFactor\":[1,1,1,1],\"metallicFactor\":0,\"roughnessFactor\":0.8}";
+      if (transparent)
+        out += ",\"alphaMode\":\"BLEND\"";
+      out += "}]";
+      out += ",\"accessors\":[" + accessors + "]";
+      out += ",\"bufferViews\":[" + views + "]";
+      out += ",\"buffers\":[{\"byteLength\":" + std::to_string(binarySize) + "}]";
+    }
+    out += '}';
+    return out;
+  }
+
+  void write(std::FILE* f, std::string json) const
+  {
+    auto put = [f](const void* data, std::size_t size)
+    {
+      if (fwrite(data, 1, size, f) != size)
+        throw Exception("Unable to write the GLB file.");
+    };
+    auto putWord = [&](uint32_t word)
+    {
+      if constexpr (std::endian::native == std::endian::big)
+        word = (word >> 24) | ((word >> 8) & 0xff00) | ((word << 8) & 0xff0000) | (word << 24);
+      put(&word, 4);
+    };
+
+    json.resize((json.size() + 3) & ~std::size_t(3), ' ');
+    const bool hasBinary = binarySize > 0;
+    putWord(0x46546C67); // "glTF"
+    putWord(2);
+    putWord(12 + 8 + json.size() + (hasBinary ? 8 + binarySize : 0));
+    putWord(json.size());
+    putWord(0x4E4F534A); // "JSON"
+    put(json.data(), json.size());
+    if (!hasBinary)
+      return;
+
+    putWord(binarySize);
+    putWord(0x004E4942); // "BIN"
+    const char padding[4] = {};
+    for (const Chunk& chunk : chunks)
+    {
+      if (std::endian::native == std::endian::big && chunk.elementSize == 4)
+      {
+        for (std::size_t i = 0; i < chunk.size; i += 4)
+          putWord(*(const uint32_t*)(chunk.data + i));
+      }
+      else
+      {
+        put(chunk.data, chunk.size);
+      }
+      put(padding, ((chunk.size + 3) & ~std::size_t(3)) - chunk.size);
+    }
+  }
+
+private:
+  struct Chunk
+  {
+    const char* data;
+    std::size_t size;
+    int elementSize;
+  };
+
+  /// Returns 'list' ready for one more element.
+  static std::string& next(std::string& list)
+  {
+    if (!list.empty())
+      list += ',';
+    return list;
+  }
+
+  std::string accessors;
+  std::string views;
+  std::string meshes;
+  std::string nodes;
+  int accessorCount{0};
+  int viewCount{0};
+  int meshCount{0};
+  int nodeCount{0};
+  std::vector<Chunk> chunks;
+  std::size_t binarySize{0};
+};
+
+/// The quaternion (xyzw) of the rotation with the columns 'c[0]', 'c[1]', 'c[2]'.
+void toQuaternion(const Vector3f c[3], float q[4])
+{
+  auto m = [&](int row, int col) { return double(c[col][row]); };
+  const double trace = m(0, 0) + m(1, 1) + m(2, 2);
+  double x, y, z, w;
+  if (trace > 0)
+  {
+    const double s = sqrt(trace + 1) * 2;
+    w = 0.25 * s;
+    x = (m(2, 1) - m(1, 2)) / s;
+    y = (m(0, 2) - m(2, 0)) / s;
+    z = (m(1, 0) - m(0, 1)) / s;
+  }
+  else if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2))
+  {
+    const double s = sqrt(1 + m(0, 0) - m(1, 1) - m(2, 2)) * 2;
+    w = (m(2, 1) - m(1, 2)) / s;
+    x = 0.25 * s;
+    y = (m(0, 1) + m(1, 0)) / s;
+    z = (m(0, 2) + m(2, 0)) / s;
+  }
+  else if (m(1, 1) > m(2, 2))
+  {
+    const double s = sqrt(1 + m(1, 1) - m(0, 0) - m(2, 2)) * 2;
+    w = (m(0, 2) - m(2, 0)) / s;
+    x = (m(0, 1) + m(1, 0)) / s;
+    y = 0.25 * s;
+    z = (m(1, 2) + m(2, 1)) / s;
+  }
+  else
+  {
+    const double s = sqrt(1 + m(2, 2) - m(0, 0) - m(1, 1)) * 2;
+    w = (m(1, 0) - m(0, 1)) / s;
+    x = (m(0, 2) + m(2, 0)) / s;
+    y = (m(1, 2) + m(2, 1)) / s;
+    z = 0.25 * s;
+  }
+  const double length = sqrt(x * x + y * y + z * z + w * w);
+  q[0] = x / length;
+  q[1] = y / length;
+  q[2] = z / length;
+  q[3] = w / length;
+}
+
+const float IdentityRotation[4] = {0, 0, 0, 1};
+}
+
+GlbRenderer::GlbRenderer(const QString& fileName, int sphereDT, int sphereDP)
+    : fileName(fileName)
+    , sphereDT(sphereDT)
+    , sphereDP(sphereDP)
+{
+}
+
+void GlbRenderer::begin()
+{
+  rgb = Vector3f(1, 0, 0);
+  alpha = 1;
+  transparent = false;
+  for (auto& shapeInstances : instances)
+    shapeInstances.clear();
+  std::fill(std::begin(lastClass), std::end(lastClass), nullptr);
+  for (auto& meshes : transformed)
+    meshes.clear();
+
+  unitMeshes[BoxShape] = createBox();
+  unitMeshes[SphereShape] = createSphere(sphereDT, sphereDP);
+  unitMeshes[GridShape] = createGrid();
+  unitMeshes[LineShape].positions = {0, 0, 0, 1, 0, 0};
+  unitMeshes[LineShape].indices = {0, 1};
+  unitMeshes[DotShape].positions = {0, 0, 0};
+  unitMeshes[DotShape].indices = {0};
+}
+
+void GlbRenderer::end()
+{
+  GlbDocument document;
+
+  static const char* const shapeNames[ShapeCount] = {"box", "sphere", "grid", "line", "dot"};
+  static const int shapeModes[ShapeCount] = {Triangles, Triangles, Lines, Lines, Points};
+  bool instancing = false;
+  for (int shape = 0; shape < ShapeCount; shape++)
+  {
+    if (instances[shape].empty())
+      continue;
+    instancing = true;
+
+    // The unit mesh is shared by the classes.
+    const int positions = document.addPositions(unitMeshes[shape].positions);
+    const int indices = document.addIndices(unitMeshes[shape].indices);
+    std::string attributes = "\"POSITION\":" + std::to_string(positions);
+    // The positions of the unit sphere are also its normals.
+    if (shape == SphereShape)
+      attributes += ",\"NORMAL\":" + std::to_string(positions);
+
+    for (const auto& [className, batch] : instances[shape])
+    {
+      const QString name = className.isEmpty()
+                               ? QString(shapeNames[shape])
+                               : QString("%1::%2").arg(shapeNames[shape]).arg(className);
+      std::string& node
+          = document.addMesh(name, attributes, indices, shapeModes[shape]);
+      node += ",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{"
+              "\"TRANSLATION\":"
+              + std::to_string(document.addFloats(batch.translations, 3, "VEC3"))
+              + ",\"ROTATION\":"
+              + std::to_string(document.addFloats(batch.rotations, 4, "VEC4"))
+              + ",\"SCALE\":" + std::to_string(document.addFloats(batch.scales, 3, "VEC3"))
+              + ",\"_COLOR_0\":" + std::to_string(document.addColors(batch.colors, 0))
+              + "}}}}";
+    }
+  }
+
+  for (int lines = 0; lines < 2; lines++)
+  {
+    for (const auto& [className, geometry] : transformed[lines])
+    {
+      const std::string attributes
+          = "\"POSITION\":" + std::to_string(document.addPositions(geometry.positions))
+            + ",\"COLOR_0\":"
+            + std::to_string(document.addColors(geometry.colors, ArrayBuffer));
+      std::string& node = document.addMesh(
+          className.isEmpty() ? QString("mesh") : className,
+          attributes,
+          document.addIndices(geometry.indices),
+          lines ? Lines : Triangles);
+      node += '}';
+    }
+  }
+
+  std::FILE* file = fopen(fileName.toLocal8Bit().data(), "wb");
+  if (!file)
+    throw Exception(QString("Unable to open file for writing: %1").arg(fileName));
+  try
+  {
+    document.write(file, document.json(transparent, instancing));
+  }
+  catch (...)
+  {
+    fclose(file);
+    throw;
+  }
+  if (fclose(file) != 0)
+    throw Exception(QString("Unable to write file: %1").arg(fileName));
+}
+
+void GlbRenderer::colorBytes(uint8_t out[4]) const
+{
+  for (int i = 0; i < 4; i++)
+  {
+    const double c = i < 3 ? rgb[i] : alpha;
+    out[i] = uint8_t(std::clamp(c, 0.0, 1.0) * 255 + 0.5);
+  }
+}
+
+auto GlbRenderer::instancesOf(Shape shape, PrimitiveClass* classID) -> InstanceBatch&
+{
+  // Consecutive primitives usually have the same class (the map nodes are stable).
+  if (classID != lastClass[shape])
+  {
+    lastClass[shape] = classID;
+    lastInstances[shape] = &instances[shape][classID->name];
+  }
+  return *lastInstances[shape];
+}
+
+void GlbRenderer::addInstance(
+    Shape shape,
+    PrimitiveClass* classID,
+    Vector3f translation,
+    const float rotation[4],
+    Vector3f scale)
+{
+  InstanceBatch& batch = instancesOf(shape, classID);
+  batch.translations.insert(
+      batch.translations.end(), {translation.x(), translation.y(), translation.z()});
+  batch.rotations.insert(batch.rotations.end(), rotation, rotation + 4);
+  batch.scales.insert(batch.scales.end(), {scale.x(), scale.y(), scale.z()});
+  uint8_t color[4];
+  colorBytes(color);
+  batch.colors.insert(batch.colors.end(), color, color + 4);
+  if (alpha < 1)
+    transparent = true;
+}
+
+auto GlbRenderer::addInstance(
+    Shape shape,
+    PrimitiveClass* classID,
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3) -> bool
+{
+  // A TRS transform has orthogonal columns.
+  Vector3f columns[3] = {dir1, dir2, dir3};
+  Vector3f scale;
+  for (int i = 0; i < 3; i++)
+  {
+    scale[i] = columns[i].length();
+    if (!(scale[i] > 0))
+      return false;
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    const int j = (i + 1) % 3;
+    if (fabs(Vector3f::dot(columns[i], columns[j])) > 1e-4 * scale[i] * scale[j])
+      return false;
+  }
+
+  for (int i = 0; i < 3; i++)
+    columns[i] = columns[i] * (1.0f / scale[i]);
+  // A mirroring is a negative scale.
+  if (Vector3f::dot(Vector3f::cross(columns[0], columns[1]), columns[2]) < 0)
+  {
+    scale[0] = -scale[0];
+    columns[0] = columns[0] * -1.0f;
+  }
+
+  float rotation[4];
+  toQuaternion(columns, rotation);
+  addInstance(shape, classID, base, rotation, scale);
+  return true;
+}
+
+void GlbRenderer::addTransformed(
+    PrimitiveClass* classID,
+    bool lines,
+    const std::vector<Vector3f>& vertices,
+    const std::vector<uint32_t>& indices)
+{
+  Geometry& g = transformed[lines][classID->name];
+  const uint32_t offset = g.positions.size() / 3;
+  uint8_t color[4];
+  colorBytes(color);
+  for (Vector3f v : vertices)
+  {
+    addVertex(g, v);
+    g.colors.insert(g.colors.end(), color, color + 4);
+  }
+  for (uint32_t index : indices)
+    g.indices.push_back(index + offset);
+  if (alpha < 1)
+    transparent = true;
+}
+
+void GlbRenderer::addTransformed(
+    Shape shape,
+    PrimitiveClass* classID,
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3)
+{
+  const Geometry& unit = unitMeshes[shape];
+  std::vector<Vector3f> vertices;
+  for (std::size_t i = 0; i < unit.positions.size(); i += 3)
+  {
+    vertices.push_back(
+        base + dir1 * unit.positions[i] + dir2 * unit.positions[i + 1]
+        + dir3 * unit.positions[i + 2]);
+  }
+  std::vector<uint32_t> indices = unit.indices;
+  // A mirroring reverses the triangles.
+  const bool lines = shape == GridShape;
+  if (!lines && Vector3f::dot(Vector3f::cross(dir1, dir2), dir3) < 0)
+  {
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+      std::swap(indices[i + 1], indices[i + 2]);
+  }
+  addTransformed(classID, lines, vertices, indices);
+}
+
+void GlbRenderer::drawBox(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  if (!addInstance(BoxShape, classID, base, dir1, dir2, dir3))
+    addTransformed(BoxShape, classID, base, dir1, dir2, dir3);
+}
+
+void GlbRenderer::drawGrid(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  if (!addInstance(GridShape, classID, base, dir1, dir2, dir3))
+    addTransformed(GridShape, classID, base, dir1, dir2, dir3);
+}
+
+void GlbRenderer::drawMesh(
+    Vector3f startBase,
+    Vector3f startDir1,
+    Vector3f startDir2,
+    Vector3f endBase,
+    Vector3f endDir1,
+    Vector3f endDir2,
+    PrimitiveClass* classID)
+{
+  // A box whose end face is spanned by the end directions.
+  std::vector<Vector3f> vertices;
+  for (int i = 0; i < 8; i++)
+  {
+    const float x = i & 1;
+    const float y = (i >> 1) & 1;
+    if (i < 4)
+      vertices.push_back(startBase + startDir1 * x + startDir2 * y);
+    else
+      vertices.push_back(endBase + endDir1 * x + endDir2 * y);
+  }
+  std::vector<uint32_t> indices = unitMeshes[BoxShape].indices;
+  if (Vector3f::dot(Vector3f::cross(startDir1, startDir2), endBase - startBase) < 0)
+  {
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+      std::swap(indices[i + 1], indices[i + 2]);
+  }
+  addTransformed(classID, false, vertices, indices);
+}
+
+void GlbRenderer::drawLine(Vector3f from, Vector3f to, PrimitiveClass* classID)
+{
+  // The unit line along the x axis, rotated onto 'to - from'.
+  const Vector3f d = to - from;
+  const float length = d.length();
+  float rotation[4] = {0, 0, 0, 1};
+  if (length > 0)
+  {
+    const Vector3f u = d * (1.0f / length);
+    if (1 + u.x() < 1e-6)
+    {
+      rotation[2] = 1;
+      rotation[3] = 0;
+    }
+    else
+    {
+      const float l = sqrt(u.z() * u.z() + u.y() * u.y() + (1 + u.x()) * (1 + u.x()));
+      rotation[1] = -u.z() / l;
+      rotation[2] = u.y() / l;
+      rotation[3] = (1 + u.x()) / l;
+    }
+  }
+  addInstance(LineShape, classID, from, rotation, Vector3f(length, 1, 1));
+}
+
+void GlbRenderer::drawDot(Vector3f pos, PrimitiveClass* classID)
+{
+  addInstance(DotShape, classID, pos, IdentityRotation, Vector3f(1, 1, 1));
+}
+
+void GlbRenderer::drawSphere(Vector3f center, float radius, PrimitiveClass* classID)
+{
+  addInstance(
+      SphereShape, classID, center, IdentityRotation, Vector3f(radius, radius, radius));
+}
+
+void GlbRenderer::drawTriangle(
+    Vector3f p1,
+    Vector3f p2,
+    Vector3f p3,
+    PrimitiveClass* classID)
+{
+  addTransformed(classID, false, {p1, p2, p3}, {0, 1, 2});
+}
+
+void GlbRenderer::drawPrimitives(
+    std::span<const PrimitiveRecord> primitives,
+    std::span<const MeshRecord> meshes)
+{
+  for (const PrimitiveRecord& p : primitives)
+  {
+    if (p.type == PrimitiveRecord::Generic)
+      continue;
+
+    rgb = Vector3f(p.rgba[0], p.rgba[1], p.rgba[2]);
+    alpha = p.rgba[3];
+    if (p.type == PrimitiveRecord::Color)
+      continue;
+
+    const AffineMatrix4f& m = p.matrix;
+    switch (p.type)
+    {
+      case PrimitiveRecord::Box:
+      case PrimitiveRecord::Grid:
+      {
+        // The columns of the matrix are those of the instance transform.
+        const Shape shape = p.type == PrimitiveRecord::Box ? BoxShape : GridShape;
+        if (!addInstance(
+                shape, p.classID, m.column(3), m.column(0), m.column(1), m.column(2)))
+          addTransformed(shape, p.classID, p.base(), p.edge(0), p.edge(1), p.edge(2));
+        break;
+      }
+      case PrimitiveRecord::Sphere:
+      {
+        const Vector3f scale(p.radius(), p.radius(), p.radius());
+        addInstance(SphereShape, p.classID, p.center(), IdentityRotation, scale);
+        break;
+      }
+      case PrimitiveRecord::Dot:
+        drawDot(p.center(), p.classID);
+        break;
+      case PrimitiveRecord::Line:
+        drawLine(m * Vector3f(0, 0.5, 0.5), m * Vector3f(1, 0.5, 0.5), p.classID);
+        break;
+      case PrimitiveRecord::Mesh:
+      {
+        const AffineMatrix4f& start = meshes[p.mesh].matrix;
+        const Vector3f startBase = start.column(3);
+        drawMesh(
+            startBase,
+            roundedEdge(startBase, start.column(0)),
+            roundedEdge(startBase, start.column(1)),
+            p.base(),
+            p.edge(0),
+            p.edge(1),
+            p.classID);
+        break;
+      }
+      case PrimitiveRecord::Triangle:
+        drawTriangle(m.column(3), m.column(0), m.column(1), p.classID);
+        break;
+      case PrimitiveRecord::Color:
+      case PrimitiveRecord::Generic:
+        break;
+    }
+  }
+}
+
+}
+}
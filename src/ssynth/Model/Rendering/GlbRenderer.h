@@ -0,0 +1,188 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/Renderer.h>
+#include <ssynth/Vector3.h>
+
+#include <QString>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// glTF 2.0 binary (GLB) file renderer.
+///
+/// Boxes, spheres, grids, lines and dots are instances of unit meshes: there is one mesh
+/// per primitive type and class, drawn by a single node with per-instance translations,
+/// rotations, scales and colors (the 'EXT_mesh_gpu_instancing' extension, with the
+/// colors in the '_COLOR_0' attribute).
+///
+/// glTF transformations can not be sheared, so triangles, meshes, and the boxes and grids
+/// with a sheared transformation are stored with transformed vertices (and vertex
+/// colors), in one mesh per class.
+///
+/// The instances are kept in a compact form until 'end' writes the file.
+class GlbRenderer : public Renderer
+{
+public:
+  GlbRenderer(const QString& fileName, int sphereDT, int sphereDP);
+  virtual ~GlbRenderer(){};
+
+  /// Flow
+  virtual void begin();
+  virtual void end();
+
+  /// This defines the identifier for our renderer.
+  virtual QString renderClass() { return "GlbRenderer"; }
+
+  /// The primitives
+  virtual void drawBox(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawMesh(
+      Math::Vector3f startBase,
+      Math::Vector3f startDir1,
+      Math::Vector3f startDir2,
+      Math::Vector3f endBase,
+      Math::Vector3f endDir1,
+      Math::Vector3f endDir2,
+      PrimitiveClass* classID);
+
+  virtual void drawGrid(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawLine(Math::Vector3f from, Math::Vector3f to, PrimitiveClass* classID);
+
+  virtual void drawDot(Math::Vector3f pos, PrimitiveClass* classID);
+
+  virtual void drawSphere(Math::Vector3f center, float radius, PrimitiveClass* classID);
+
+  virtual void drawTriangle(
+      Math::Vector3f p1,
+      Math::Vector3f p2,
+      Math::Vector3f p3,
+      PrimitiveClass* classID);
+
+  virtual void callGeneric(PrimitiveClass*){};
+
+  /// Decomposes the matrices of the boxes and grids directly into instance transforms.
+  virtual void drawPrimitives(
+      std::span<const PrimitiveRecord> primitives,
+      std::span<const MeshRecord> meshes);
+
+  // Color
+  // RGB in [0;1] intervals.
+  virtual void setColor(Math::Vector3f rgb) { this->rgb = rgb; }
+  virtual void setBackgroundColor(Math::Vector3f /*rgb*/){};
+  virtual void setAlpha(double alpha) { this->alpha = alpha; }
+
+  virtual void setPreviousColor(Math::Vector3f /*rgb*/){};
+  virtual void setPreviousAlpha(double /*alpha*/){};
+
+  // Camera settings
+  virtual void setTranslation(Math::Vector3f /*translation*/){};
+  virtual void setScale(double /*scale*/){};
+  virtual void setRotation(Math::Matrix4f /*rotation*/){};
+  virtual void setPivot(Math::Vector3f /*pivot*/){};
+  virtual void setPerspectiveAngle(double /*angle*/){};
+
+  // Issues a command for a specific renderclass such as 'template' or 'opengl'
+  virtual void callCommand(const QString& /*renderClass*/, const QString& /*command*/){};
+
+  /// The unit meshes, and the kind of geometry stored in a mesh.
+  enum Shape
+  {
+    BoxShape,
+    SphereShape,
+    GridShape,
+    LineShape,
+    DotShape,
+    ShapeCount
+  };
+
+  /// Indexed geometry (the vertex colors are only used for the transformed meshes).
+  struct Geometry
+  {
+    std::vector<float> positions; // xyz
+    std::vector<uint8_t> colors;  // rgba
+    std::vector<uint32_t> indices;
+  };
+
+  /// The instances of a unit mesh.
+  struct InstanceBatch
+  {
+    std::vector<float> translations; // xyz
+    std::vector<float> rotations;    // Quaternions (xyzw)
+    std::vector<float> scales;       // xyz
+    std::vector<uint8_t> colors;     // rgba
+  };
+
+private:
+  /// The instances of 'shape' for 'classID'.
+  InstanceBatch& instancesOf(Shape shape, PrimitiveClass* classID);
+
+  /// Adds an instance of 'shape', whose unit geometry is mapped by the columns
+  /// 'dir1', 'dir2', 'dir3' and 'base'. Returns false if that is not a TRS transform.
+  bool addInstance(
+      Shape shape,
+      PrimitiveClass* classID,
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3);
+  void addInstance(
+      Shape shape,
+      PrimitiveClass* classID,
+      Math::Vector3f translation,
+      const float rotation[4],
+      Math::Vector3f scale);
+
+  /// Adds 'vertices' (referenced by 'indices') to the transformed mesh of the class.
+  void addTransformed(
+      PrimitiveClass* classID,
+      bool lines,
+      const std::vector<Math::Vector3f>& vertices,
+      const std::vector<uint32_t>& indices);
+  /// Adds a unit mesh mapped by the columns 'dir1', 'dir2', 'dir3' and 'base'.
+  void addTransformed(
+      Shape shape,
+      PrimitiveClass* classID,
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3);
+
+  void colorBytes(uint8_t out[4]) const;
+
+  QString fileName;
+  int sphereDT;
+  int sphereDP;
+  Math::Vector3f rgb;
+  double alpha;
+  bool transparent{false};
+
+  Geometry unitMeshes[ShapeCount];
+  std::map<QString, InstanceBatch> instances[ShapeCount]; // By class name
+  // The last class used for each shape, and its instances.
+  PrimitiveClass* lastClass[ShapeCount]{};
+  InstanceBatch* lastInstances[ShapeCount]{};
+  std::map<QString, Geometry> transformed[2];             // Triangles, lines
+};
+
+}
+}
+}
@@ -0,0 +1,118 @@
+#include <ssynth/Model/Rendering/MeshRenderer.h>
+
+namespace ssynth
+{
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+void MeshRenderer::begin()
+{
+  ObjRenderer::begin();
+  groups.clear();
+  groupIndices.clear();
+  lastGroup.clear();
+  lastGroupIndex = -1;
+}
+
+auto MeshRenderer::group() -> MeshGroup&
+{
+  // Consecutive primitives are usually in the same group.
+  if (lastGroupIndex == -1 || currentGroup != lastGroup)
+  {
+    auto [it, inserted] = groupIndices.try_emplace(currentGroup, (int)groups.size());
+    if (inserted)
+      groups.emplace_back(currentGroup);
+    lastGroup = currentGroup;
+    lastGroupIndex = it->second;
+  }
+  return groups[lastGroupIndex];
+}
+
+auto MeshRenderer::addVertex(MeshGroup& g, const Vector3f& position, const Vector3f& normal)
+    -> uint32_t
+{
+  const uint32_t index = g.vertexCount();
+  g.positions.insert(g.positions.end(), {position.x(), position.y(), position.z()});
+  g.normals.insert(g.normals.end(), {normal.x(), normal.y(), normal.z()});
+  g.colors.insert(g.colors.end(), {rgb.x(), rgb.y(), rgb.z(), float(alpha)});
+  return index;
+}
+
+void MeshRenderer::addPrimitive(ObjGroup& primitive)
+{
+  MeshGroup& g = group();
+
+  // A vertex is shared by the faces using it with the same normal.
+  firstCorner.assign(primitive.vertices.size(), -1);
+  corners.clear();
+  auto vertex = [&](const VertexNormal& vn) -> uint32_t
+  {
+    int& first = firstCorner[vn.vID - 1];
+    for (int c = first; c != -1; c = corners[c].next)
+    {
+      if (corners[c].normal == vn.nID)
+        return corners[c].index;
+    }
+    const uint32_t index = addVertex(
+        g,
+        primitive.vertices[vn.vID - 1],
+        vn.nID == -1 ? Vector3f() : primitive.normals[vn.nID - 1]);
+    corners.push_back(Corner{vn.nID, index, first});
+    first = corners.size() - 1;
+    return index;
+  };
+
+  for (const std::vector<VertexNormal>& face : primitive.faces)
+  {
+    if (face.size() == 1)
+    {
+      g.points.push_back(vertex(face[0]));
+    }
+    else if (face.size() == 2)
+    {
+      g.lines.insert(g.lines.end(), {vertex(face[0]), vertex(face[1])});
+    }
+    else if (face[0].nID != -1)
+    {
+      // Triangle fan.
+      const uint32_t v0 = vertex(face[0]);
+      uint32_t previous = vertex(face[1]);
+      for (int i = 2; i < face.size(); i++)
+      {
+        const uint32_t v = vertex(face[i]);
+        g.triangles.insert(g.triangles.end(), {v0, previous, v});
+        previous = v;
+      }
+    }
+    else
+    {
+      // No normals (triangles): the face gets its own vertices, with its normal.
+      const Vector3f& p0 = primitive.vertices[face[0].vID - 1];
+      Vector3f normal = Vector3f::cross(
+          primitive.vertices[face[1].vID - 1] - p0,
+          primitive.vertices[face[2].vID - 1] - p0);
+      if (normal.sqrLength() > 0)
+        normal.normalize();
+
+      const uint32_t v0 = addVertex(g, p0, normal);
+      for (int i = 1; i < face.size(); i++)
+        addVertex(g, primitive.vertices[face[i].vID - 1], normal);
+      for (int i = 2; i < face.size(); i++)
+        g.triangles.insert(g.triangles.end(), {v0, v0 + i - 1, v0 + i});
+    }
+  }
+}
+
+void MeshRenderer::addInstance(const ObjGroup& mesh, const AffineMatrix4f& m)
+{
+  instance.vertices.clear();
+  instance.normals.clear();
+  instance.faces.clear();
+  instance.addGroup(mesh, m);
+  addPrimitive(instance);
+}
+
+}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/ObjRenderer.h>
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// The geometry of a group, as contiguous vertex and index buffers (ready to be
+/// uploaded to a GPU).
+///
+/// Every vertex has a position, a normal and an RGBA color. The indices (from 0) form
+/// triangles, lines (from the grids and lines) and points (from the dots).
+/// Lines and points have zero normals.
+class MeshGroup
+{
+public:
+  MeshGroup(const QString& name)
+      : name(name){};
+
+  const QString& getName() const { return name; }
+  int vertexCount() const { return positions.size() / 3; }
+
+  std::span<const float> getPositions() const { return positions; } // xyz
+  std::span<const float> getNormals() const { return normals; }     // xyz
+  std::span<const float> getColors() const { return colors; }       // rgba
+  std::span<const uint32_t> getTriangles() const { return triangles; }
+  std::span<const uint32_t> getLines() const { return lines; }
+  std::span<const uint32_t> getPoints() const { return points; }
+
+private:
+  friend class MeshRenderer;
+
+  QString name;
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> colors;
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> lines;
+  std::vector<uint32_t> points;
+};
+
+/// In-memory mesh renderer, for applications using the geometry directly.
+///
+/// The primitives are tessellated as by the ObjRenderer, and grouped by class (and
+/// optionally by color), in the order the groups were first drawn. The buffers are
+/// cleared by 'begin', and stay valid until the next 'begin' or draw call.
+class MeshRenderer : public ObjRenderer
+{
+public:
+  MeshRenderer(int sphereDT, int sphereDP, bool groupByColor = false)
+      : ObjRenderer(sphereDT, sphereDP, true, groupByColor){};
+  virtual ~MeshRenderer(){};
+
+  virtual void begin();
+
+  virtual QString renderClass() { return "MeshRenderer"; }
+
+  std::span<const MeshGroup> getGroups() const { return groups; }
+
+protected:
+  virtual void addPrimitive(ObjGroup& primitive);
+  virtual void addInstance(const ObjGroup& mesh, const Math::AffineMatrix4f& m);
+
+private:
+  MeshGroup& group();
+  uint32_t addVertex(MeshGroup& g, const Vector3f& position, const Vector3f& normal);
+
+  std::vector<MeshGroup> groups;
+  std::map<QString, int> groupIndices;
+  QString lastGroup;
+  int lastGroupIndex{-1};
+
+  // Per primitive: the output vertex of each (vertex, normal) pair, chained by vertex.
+  struct Corner
+  {
+    int normal;
+    uint32_t index;
+    int next;
+  };
+  std::vector<int> firstCorner;
+  std::vector<Corner> corners;
+  ObjGroup instance;
+};
+
+}
+}
+}
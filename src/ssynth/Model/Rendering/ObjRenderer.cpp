@@ -3,6 +3,12 @@
 
 #include <QColor>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
 namespace ssynth
 {
 using namespace Math;
@@ -31,62 +37,182 @@ void ObjGroup::addGroup(ObjGroup g)
     for (auto& j : face)
     {
       j.vID = j.vID + vertexCount;
-      j.nID = j.nID + normalCount;
+      if (j.nID != -1)
+        j.nID = j.nID + normalCount;
     }
     faces.push_back(face);
   }
 }
 
-// Removes redundant vertices.
-void ObjGroup::reduceVertices()
+void ObjGroup::addGroup(const ObjGroup& g, const AffineMatrix4f& m)
 {
-  std::vector<Vector3f> newVertices;
-  std::vector<Vector3f> newNormals;
-  std::map<int, int> oldToNewVertex;
-  std::map<int, int> oldToNewNormals;
+  const int vertexCount = vertices.size();
+  const int normalCount = normals.size();
+
+  vertices.resize(vertexCount + g.vertices.size());
+  for (int i = 0; i < g.vertices.size(); i++)
+  {
+    vertices[vertexCount + i] = m * g.vertices[i];
+  }
+  normals.insert(normals.end(), g.normals.begin(), g.normals.end());
 
-  // Reduce vertices and normals (if present)
-  for (int i = 0; i < vertices.size(); i++)
+  for (const auto& face : g.faces)
   {
-    auto it = std::find(newVertices.begin(), newVertices.end(), vertices[i]);
-    if (it == newVertices.end())
+    auto& f = faces.emplace_back(face);
+    for (auto& j : f)
     {
-      newVertices.push_back(vertices[i]);
-      oldToNewVertex[i] = newVertices.size() - 1;
+      j.vID = j.vID + vertexCount;
+      if (j.nID != -1)
+        j.nID = j.nID + normalCount;
     }
-    else
+  }
+}
+
+namespace
+{
+uint32_t floatBits(float f)
+{
+  f += 0.0f; // -0 and +0 are equal.
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+uint64_t hashPoint(const Vector3f& v)
+{
+  uint64_t h = floatBits(v.x());
+  h = (h * 0x9E3779B97F4A7C15ull) ^ floatBits(v.y());
+  h = (h * 0x9E3779B97F4A7C15ull) ^ floatBits(v.z());
+  return (h * 0x9E3779B97F4A7C15ull) >> 29;
+}
+
+// Removes the duplicates from 'points' (keeping the order of the first occurrences),
+// and returns the new index of every point. Uses an open-addressing hash table.
+std::vector<int> weldIdentical(std::vector<Vector3f>& points)
+{
+  const int n = points.size();
+  size_t size = 16;
+  while (size < 2 * (size_t)n)
+    size *= 2;
+  std::vector<int> slots(size, -1);
+  std::vector<int> remap(n);
+
+  int count = 0;
+  for (int i = 0; i < n; i++)
+  {
+    for (size_t h = hashPoint(points[i]);; h++)
     {
-      oldToNewVertex[i] = std::distance(newVertices.begin(), it);
+      int& slot = slots[h & (size - 1)];
+      if (slot == -1)
+      {
+        slot = count;
+        points[count] = points[i];
+        remap[i] = count++;
+        break;
+      }
+      if (points[slot] == points[i])
+      {
+        remap[i] = slot;
+        break;
+      }
     }
   }
+  points.resize(count);
+  return remap;
+}
 
-  // Reduce vertices and normals (if present)
-  for (int i = 0; i < normals.size(); i++)
+// Cells far apart may share a key, this only costs a few extra distance checks.
+uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+{
+  return ((uint64_t)x & 0x1FFFFF) | ((uint64_t)y & 0x1FFFFF) << 21
+         | ((uint64_t)z & 0x1FFFFF) << 42;
+}
+
+// The cell of coordinate 'v'. The quotient is clamped (tiny epsilons or huge
+// coordinates would overflow int64_t): the points beyond the limit share the last cell,
+// which is still adjacent to the cells below it.
+int64_t cellCoordinate(float v, float epsilon)
+{
+  constexpr double limit = 1ll << 52;
+  return std::clamp(std::floor(double(v) / epsilon), -limit, limit);
+}
+
+// As 'weldIdentical', but merges points closer than 'epsilon' in every coordinate.
+// The points are sorted into cells of size 'epsilon', so only the neighbouring cells
+// have to be searched.
+std::vector<int> weldClose(std::vector<Vector3f>& points, float epsilon)
+{
+  const int n = points.size();
+  std::unordered_map<uint64_t, int> cells; // The last point in each cell.
+  std::vector<int> previousInCell;
+  std::vector<int> remap(n);
+  cells.reserve(n);
+  previousInCell.reserve(n);
+
+  int count = 0;
+  for (int i = 0; i < n; i++)
   {
-    auto it = std::find(newNormals.begin(), newNormals.end(), normals[i]);
-    if (it == newNormals.end())
+    const Vector3f p = points[i];
+    if (!std::isfinite(p.x()) || !std::isfinite(p.y()) || !std::isfinite(p.z()))
     {
-      newNormals.push_back(normals[i]);
-      oldToNewNormals[i] = newNormals.size() - 1;
+      // Never merged.
+      points[count] = p;
+      previousInCell.push_back(-1);
+      remap[i] = count++;
+      continue;
     }
-    else
+
+    const int64_t cx = cellCoordinate(p.x(), epsilon);
+    const int64_t cy = cellCoordinate(p.y(), epsilon);
+    const int64_t cz = cellCoordinate(p.z(), epsilon);
+    int match = -1;
+    for (int dx = -1; dx <= 1; dx++)
+      for (int dy = -1; dy <= 1; dy++)
+        for (int dz = -1; dz <= 1; dz++)
+        {
+          auto it = cells.find(cellKey(cx + dx, cy + dy, cz + dz));
+          for (int j = (it == cells.end()) ? -1 : it->second; j != -1;
+               j = previousInCell[j])
+          {
+            const Vector3f d = points[j] - p;
+            if ((match == -1 || j < match) && std::abs(d.x()) <= epsilon
+                && std::abs(d.y()) <= epsilon && std::abs(d.z()) <= epsilon)
+              match = j;
+          }
+        }
+
+    if (match != -1)
     {
-      oldToNewNormals[i] = std::distance(newNormals.begin(), it);
+      remap[i] = match;
+      continue;
     }
+    int& last = cells.try_emplace(cellKey(cx, cy, cz), -1).first->second;
+    previousInCell.push_back(last);
+    last = count;
+    points[count] = p;
+    remap[i] = count++;
   }
+  points.resize(count);
+  return remap;
+}
+}
+
+void ObjGroup::reduceVertices(float epsilon)
+{
+  const std::vector<int> newVertex
+      = epsilon > 0 ? weldClose(vertices, epsilon) : weldIdentical(vertices);
+  const std::vector<int> newNormal = weldIdentical(normals);
 
   // Update indices
   for (auto& face : faces)
   {
     for (auto& j : face)
     {
-      j.vID = oldToNewVertex[j.vID - 1] + 1; // beware OBJ is 1-based!
-      j.nID = oldToNewNormals[j.nID - 1] + 1;
+      j.vID = newVertex[j.vID - 1] + 1; // beware OBJ is 1-based!
+      if (j.nID != -1)
+        j.nID = newNormal[j.nID - 1] + 1;
     }
   }
-
-  vertices = newVertices;
-  normals = newNormals;
 }
 
 namespace
@@ -95,13 +221,13 @@ namespace
                 This function was taken from Paul Bourkes website:
                 http://local.wasp.uwa.edu.au/~pbourke/miscellaneous/sphere_cylinder/
 
-                Create a unit sphere centered at the origin
+                Create a unit sphere centered at the origin (with merged vertices)
                 This code illustrates the concept rather than implements it efficiently
                 It is called with two arguments, the theta and phi angle increments in degrees
                 Note that at the poles only 3 vertex facet result
                 while the rest of the sphere has 4 point facets
                 */
-void CreateUnitSphere(int dt, int dp, ObjGroup& motherGroup, Matrix4f m)
+ObjGroup CreateUnitSphere(int dt, int dp)
 {
   float DTOR = 3.1415f / 180.0f;
   double dtheta = 180.0 / dt;
@@ -116,12 +242,10 @@ void CreateUnitSphere(int dt, int dp, ObjGroup& motherGroup, Matrix4f m)
       int vi = group.vertices.size() + 1;
       int vn = group.normals.size() + 1;
 
-      group.vertices.push_back(
-          m
-          * Vector3f(
-              cos(theta * DTOR) * cos(phi * DTOR),
-              cos(theta * DTOR) * sin(phi * DTOR),
-              sin(theta * DTOR)));
+      group.vertices.emplace_back(
+          cos(theta * DTOR) * cos(phi * DTOR),
+          cos(theta * DTOR) * sin(phi * DTOR),
+          sin(theta * DTOR));
       group.normals.emplace_back(
           cos(theta * DTOR) * cos(phi * DTOR),
           cos(theta * DTOR) * sin(phi * DTOR),
@@ -130,12 +254,10 @@ void CreateUnitSphere(int dt, int dp, ObjGroup& motherGroup, Matrix4f m)
       std::vector<VertexNormal> vns;
       if (theta > -90 && theta < 90)
       {
-        group.vertices.push_back(
-            m
-            * Vector3f(
-                cos(theta * DTOR) * cos((phi + dphi) * DTOR),
-                cos(theta * DTOR) * sin((phi + dphi) * DTOR),
-                sin(theta * DTOR)));
+        group.vertices.emplace_back(
+            cos(theta * DTOR) * cos((phi + dphi) * DTOR),
+            cos(theta * DTOR) * sin((phi + dphi) * DTOR),
+            sin(theta * DTOR));
         group.normals.emplace_back(
             cos(theta * DTOR) * cos((phi + dphi) * DTOR),
             cos(theta * DTOR) * sin((phi + dphi) * DTOR),
@@ -148,22 +270,18 @@ void CreateUnitSphere(int dt, int dp, ObjGroup& motherGroup, Matrix4f m)
         for (int j = 0; j < 3; j++)
           vns.emplace_back(j + vi, j + vn);
       }
-      group.vertices.push_back(
-          m
-          * Vector3f(
-              cos((theta + dtheta) * DTOR) * cos((phi + dphi) * DTOR),
-              cos((theta + dtheta) * DTOR) * sin((phi + dphi) * DTOR),
-              sin((theta + dtheta) * DTOR)));
+      group.vertices.emplace_back(
+          cos((theta + dtheta) * DTOR) * cos((phi + dphi) * DTOR),
+          cos((theta + dtheta) * DTOR) * sin((phi + dphi) * DTOR),
+          sin((theta + dtheta) * DTOR));
       group.normals.emplace_back(
           cos((theta + dtheta) * DTOR) * cos((phi + dphi) * DTOR),
           cos((theta + dtheta) * DTOR) * sin((phi + dphi) * DTOR),
           sin((theta + dtheta) * DTOR));
-      group.vertices.push_back(
-          m
-          * Vector3f(
-              cos((theta + dtheta) * DTOR) * cos(phi * DTOR),
-              cos((theta + dtheta) * DTOR) * sin(phi * DTOR),
-              sin((theta + dtheta) * DTOR)));
+      group.vertices.emplace_back(
+          cos((theta + dtheta) * DTOR) * cos(phi * DTOR),
+          cos((theta + dtheta) * DTOR) * sin(phi * DTOR),
+          sin((theta + dtheta) * DTOR));
       group.normals.emplace_back(
           cos((theta + dtheta) * DTOR) * cos(phi * DTOR),
           cos((theta + dtheta) * DTOR) * sin(phi * DTOR),
@@ -171,8 +289,7 @@ void CreateUnitSphere(int dt, int dp, ObjGroup& motherGroup, Matrix4f m)
       group.faces.push_back(vns);
     }
   }
-  group.reduceVertices();
-  motherGroup.addGroup(group);
+  return group;
 }
 
 }
@@ -194,7 +311,7 @@ void ObjRenderer::addLineQuad(
   {
     std::vector<VertexNormal> vns;
     vns.emplace_back(vi + j, -1);
-    vns.emplace_back(vi + (j + 1 % 4), -1);
+    vns.emplace_back(vi + (j + 1) % 4, -1);
     group.faces.push_back(vns);
   }
 }
@@ -236,20 +353,166 @@ void ObjRenderer::setClass(const QString& classID, Vector3f rgb, double /*alpha*
     className += QColor(int(rgb[0] * 255), int(rgb[1] * 255), int(rgb[2] * 255)).name();
   if (className.isEmpty())
     className = "default";
+  streamFullGroup();
   if (!groups.contains(className))
     groups[className] = ObjGroup();
   groups[className].groupName = className;
   currentGroup = className;
 }
 
+void ObjRenderer::streamFullGroup()
+{
+  if (streamWriter && !currentGroup.isEmpty())
+  {
+    ObjGroup& group = groups[currentGroup];
+    if (group.vertices.size() >= streamChunkVertices)
+      writeGroup(*streamWriter, group);
+  }
+}
+
+void ObjRenderer::drawPrimitives(
+    std::span<const PrimitiveRecord> primitives,
+    std::span<const MeshRecord> meshes)
+{
+  const PrimitiveClass* lastClass = nullptr;
+  Vector3f lastRgb;
+  for (const PrimitiveRecord& p : primitives)
+  {
+    if (p.type == PrimitiveRecord::Generic)
+    {
+      callGeneric(p.classID);
+      continue;
+    }
+
+    rgb = Vector3f(p.rgba[0], p.rgba[1], p.rgba[2]);
+    alpha = p.rgba[3];
+    if (p.type == PrimitiveRecord::Color)
+      continue;
+
+    if (p.classID != lastClass || (groupByColor && rgb != lastRgb))
+    {
+      setClass(p.classID->name, rgb, alpha);
+      lastClass = p.classID;
+      lastRgb = rgb;
+    }
+    else
+    {
+      // As 'setClass', which is skipped.
+      streamFullGroup();
+    }
+
+    const AffineMatrix4f& m = p.matrix;
+    switch (p.type)
+    {
+      case PrimitiveRecord::Box:
+        addBox(p.base(), p.edge(0), p.edge(1), p.edge(2));
+        break;
+      case PrimitiveRecord::Grid:
+        addGrid(p.base(), p.edge(0), p.edge(1), p.edge(2));
+        break;
+      case PrimitiveRecord::Sphere:
+        addSphere(p.center(), p.radius());
+        break;
+      case PrimitiveRecord::Dot:
+        addDot(p.center());
+        break;
+      case PrimitiveRecord::Line:
+        addLine(m * Vector3f(0, 0.5, 0.5), m * Vector3f(1, 0.5, 0.5));
+        break;
+      case PrimitiveRecord::Mesh:
+      {
+        const AffineMatrix4f& start = meshes[p.mesh].matrix;
+        const Vector3f startBase = start.column(3);
+        addMesh(
+            startBase,
+            roundedEdge(startBase, start.column(0)),
+            roundedEdge(startBase, start.column(1)),
+            p.base(),
+            p.edge(0),
+            p.edge(1));
+        break;
+      }
+      case PrimitiveRecord::Triangle:
+        addTriangle(m.column(3), m.column(0), m.column(1));
+        break;
+      case PrimitiveRecord::Color:
+      case PrimitiveRecord::Generic:
+        break;
+    }
+  }
+}
+
 void ObjRenderer::drawBox(
-    Math::Vector3f O,
-    Math::Vector3f v1,
-    Math::Vector3f v2,
-    Math::Vector3f v3,
+    Math::Vector3f base,
+    Math::Vector3f dir1,
+    Math::Vector3f dir2,
+    Math::Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addBox(base, dir1, dir2, dir3);
+}
+
+void ObjRenderer::drawMesh(
+    Math::Vector3f startBase,
+    Math::Vector3f startDir1,
+    Math::Vector3f startDir2,
+    Math::Vector3f endBase,
+    Math::Vector3f endDir1,
+    Math::Vector3f endDir2,
+    PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addMesh(startBase, startDir1, startDir2, endBase, endDir1, endDir2);
+}
+
+void ObjRenderer::drawGrid(
+    Math::Vector3f base,
+    Math::Vector3f dir1,
+    Math::Vector3f dir2,
+    Math::Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addGrid(base, dir1, dir2, dir3);
+}
+
+void ObjRenderer::drawLine(
+    Math::Vector3f from,
+    Math::Vector3f to,
+    PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addLine(from, to);
+}
+
+void ObjRenderer::drawTriangle(
+    Math::Vector3f p1,
+    Math::Vector3f p2,
+    Math::Vector3f p3,
+    PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addTriangle(p1, p2, p3);
+}
+
+void ObjRenderer::drawDot(Math::Vector3f v, PrimitiveClass* classID)
+{
+  setClass(classID->name, rgb, alpha);
+  addDot(v);
+}
+
+void ObjRenderer::drawSphere(
+    Math::Vector3f center,
+    float radius,
     PrimitiveClass* classID)
 {
   setClass(classID->name, rgb, alpha);
+  addSphere(center, radius);
+}
+
+void ObjRenderer::addBox(Vector3f O, Vector3f v1, Vector3f v2, Vector3f v3)
+{
   ObjGroup group;
   addQuad(group, O, O + v2, O + v2 + v1, O + v1);
   addQuad(group, O + v3, O + v1 + v3, O + v2 + v1 + v3, O + v2 + v3);
@@ -257,20 +520,18 @@ void ObjRenderer::drawBox(
   addQuad(group, O + v1, O + v2 + v1, O + v3 + v2 + v1, O + v3 + v1);
   addQuad(group, O, O + v1, O + v3 + v1, O + v3);
   addQuad(group, O + v2, O + v3 + v2, O + v3 + v2 + v1, O + v1 + v2);
-  group.reduceVertices();
-  groups[currentGroup].addGroup(group);
-};
+  reducePrimitive(group);
+  addPrimitive(group);
+}
 
-void ObjRenderer::drawMesh(
-    Math::Vector3f O,
-    Math::Vector3f v1,
-    Math::Vector3f v2,
-    Math::Vector3f endBase,
-    Math::Vector3f u1,
-    Math::Vector3f u2,
-    PrimitiveClass* classID)
+void ObjRenderer::addMesh(
+    Vector3f O,
+    Vector3f v1,
+    Vector3f v2,
+    Vector3f endBase,
+    Vector3f u1,
+    Vector3f u2)
 {
-  setClass(classID->name, rgb, alpha);
   ObjGroup group;
   Vector3f v3 = endBase - O;
   addQuad(group, O, O + v2, O + v2 + v1, O + v1);
@@ -279,18 +540,12 @@ void ObjRenderer::drawMesh(
   addQuad(group, O + v1, O + v2 + v1, O + v3 + u2 + u1, O + v3 + u1);
   addQuad(group, O, O + v1, O + v3 + u1, O + v3);
   addQuad(group, O + v2, O + v3 + u2, O + v3 + u2 + u1, O + v1 + v2);
-  group.reduceVertices();
-  groups[currentGroup].addGroup(group);
-};
+  reducePrimitive(group);
+  addPrimitive(group);
+}
 
-void ObjRenderer::drawGrid(
-    Math::Vector3f O,
-    Math::Vector3f v1,
-    Math::Vector3f v2,
-    Math::Vector3f v3,
-    PrimitiveClass* classID)
+void ObjRenderer::addGrid(Vector3f O, Vector3f v1, Vector3f v2, Vector3f v3)
 {
-  setClass(classID->name, rgb, alpha);
   ObjGroup group;
   addLineQuad(group, O, O + v2, O + v2 + v1, O + v1);
   addLineQuad(group, O + v3, O + v1 + v3, O + v2 + v1 + v3, O + v2 + v3);
@@ -298,16 +553,12 @@ void ObjRenderer::drawGrid(
   addLineQuad(group, O + v1, O + v2 + v1, O + v3 + v2 + v1, O + v3 + v1);
   addLineQuad(group, O, O + v1, O + v3 + v1, O + v3);
   addLineQuad(group, O + v2, O + v3 + v2, O + v3 + v2 + v1, O + v1 + v2);
-  group.reduceVertices();
-  groups[currentGroup].addGroup(group);
-};
+  reducePrimitive(group);
+  addPrimitive(group);
+}
 
-void ObjRenderer::drawLine(
-    Math::Vector3f from,
-    Math::Vector3f to,
-    PrimitiveClass* classID)
+void ObjRenderer::addLine(Vector3f from, Vector3f to)
 {
-  setClass(classID->name, rgb, alpha);
   ObjGroup group;
   group.vertices.push_back(from);
   group.vertices.push_back(to);
@@ -315,16 +566,11 @@ void ObjRenderer::drawLine(
   vns.emplace_back(1, -1);
   vns.emplace_back(2, -1);
   group.faces.push_back(vns);
-  groups[currentGroup].addGroup(group);
-};
+  addPrimitive(group);
+}
 
-void ObjRenderer::drawTriangle(
-    Math::Vector3f p1,
-    Math::Vector3f p2,
-    Math::Vector3f p3,
-    PrimitiveClass* classID)
+void ObjRenderer::addTriangle(Vector3f p1, Vector3f p2, Vector3f p3)
 {
-  setClass(classID->name, rgb, alpha);
   ObjGroup group;
   group.vertices.push_back(p1);
   group.vertices.push_back(p2);
@@ -335,32 +581,63 @@ void ObjRenderer::drawTriangle(
   for (int j = 0; j < 3; j++)
     vns.emplace_back(1 + j, -1);
   group.faces.push_back(vns);
-  groups[currentGroup].addGroup(group);
+  addPrimitive(group);
 }
 
-void ObjRenderer::drawDot(Math::Vector3f v, PrimitiveClass* classID)
+void ObjRenderer::addDot(Vector3f v)
 {
-  setClass(classID->name, rgb, alpha);
   ObjGroup group;
   group.vertices.push_back(v);
   std::vector<VertexNormal> vns;
   vns.emplace_back(1, -1);
   group.faces.push_back(vns);
-  groups[currentGroup].addGroup(group);
-};
+  addPrimitive(group);
+}
 
-void ObjRenderer::drawSphere(
-    Math::Vector3f center,
-    float radius,
-    PrimitiveClass* classID)
+void ObjRenderer::addSphere(Vector3f center, float radius)
 {
-  setClass(classID->name, rgb, alpha);
+  // The unit sphere is only tessellated once.
+  if (unitSphere.faces.empty())
+  {
+    unitSphere = CreateUnitSphere(sphereDT, sphereDP);
+    weldedUnitSphere = unitSphere;
+    weldedUnitSphere.reduceVertices();
+  }
 
-  Matrix4f m = Matrix4f::Translation(center.x(), center.y(), center.z())
-               * (Matrix4f::ScaleMatrix(radius));
+  // With a tolerance, the vertices are welded once they are transformed (see
+  // 'addInstance'), as the tolerance applies to the scene coordinates.
+  const bool weldsInstances = weldEpsilon > 0 && !weldGroups;
+  addInstance(
+      weldsInstances ? unitSphere : weldedUnitSphere,
+      AffineMatrix4f(
+          Matrix4f::Translation(center.x(), center.y(), center.z())
+          * (Matrix4f::ScaleMatrix(radius))));
+}
 
-  CreateUnitSphere(sphereDT, sphereDP, groups[currentGroup], m);
-};
+void ObjRenderer::addPrimitive(ObjGroup& primitive)
+{
+  groups[currentGroup].addGroup(std::move(primitive));
+}
+
+void ObjRenderer::addInstance(const ObjGroup& mesh, const AffineMatrix4f& m)
+{
+  if (weldEpsilon > 0 && !weldGroups)
+  {
+    // The transformed vertices may be closer than the tolerance.
+    ObjGroup group;
+    group.addGroup(mesh, m);
+    group.reduceVertices(weldEpsilon);
+    groups[currentGroup].addGroup(std::move(group));
+    return;
+  }
+  groups[currentGroup].addGroup(mesh, m);
+}
+
+void ObjRenderer::reducePrimitive(ObjGroup& group) const
+{
+  if (!weldGroups)
+    group.reduceVertices(weldEpsilon);
+}
 
 void ObjRenderer::begin()
 {
@@ -370,64 +647,33 @@ void ObjRenderer::begin()
 
 void ObjRenderer::end(){};
 
-void ObjRenderer::writeToStream(QTextStream& ts)
+void ObjRenderer::writeGroup(ObjWriter& writer, ObjGroup& group)
 {
-  int vertexCount = 0;
-  int normalCount = 0;
-
-  for (const auto& [key, o] : groups)
-  {
-    // Group name
-    INFO(o.groupName);
-    ts << "g " << o.groupName << Qt::endl;
-    ts << "usemtl " << o.groupName << Qt::endl;
+  if (weldGroups)
+    group.reduceVertices(weldEpsilon);
+  writer.writeGroup(group);
 
-    // Vertices
-    for (Vector3f v : o.vertices)
-    {
-      ts << "v " << QString::number(v.x()) << " " << QString::number(v.y()) << " "
-         << QString::number(v.z()) << " " << Qt::endl;
-    }
-
-    // Normals
-    for (Vector3f v : o.normals)
-    {
-      ts << "vn " << QString::number(v.x()) << " " << QString::number(v.y()) << " "
-         << QString::number(v.z()) << " " << Qt::endl;
-    }
+  group.vertices.clear();
+  group.normals.clear();
+  group.faces.clear();
+}
 
-    // Faces
-    for (const std::vector<VertexNormal>& vi : o.faces)
-    {
-      if (vi.size() == 1)
-      {
-        ts << "p ";
-      }
-      else if (vi.size() == 2)
-      {
-        ts << "l ";
-      }
-      else
-      {
-        ts << "f ";
-      }
-      for (VertexNormal vn : vi)
-      {
-        if (vn.nID == -1)
-        {
-          ts << QString::number(vn.vID + vertexCount) << " ";
-        }
-        else
-        {
-          ts << QString::number(vn.vID + vertexCount) << "//"
-             << QString::number(vn.nID + normalCount) << " ";
-        }
-      }
-      ts << Qt::endl;
-    }
-    vertexCount += o.vertices.size();
-    normalCount += o.normals.size();
+void ObjRenderer::write(ObjWriter& writer)
+{
+  for (auto& [key, group] : groups)
+  {
+    INFO(group.groupName);
+    writeGroup(writer, group);
   }
+  writer.flush();
+}
+
+void ObjRenderer::writeToStream(QTextStream& ts)
+{
+  ObjWriter writer(
+      [&ts](const char* data, std::size_t size)
+      { ts << QString::fromUtf8(data, size); });
+  write(writer);
 };
 
 }
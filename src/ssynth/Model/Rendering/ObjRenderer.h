@@ -1,6 +1,8 @@
 #pragma once
 
+#include <ssynth/AffineMatrix4.h>
 #include <ssynth/Matrix4.h>
+#include <ssynth/Model/Rendering/ObjWriter.h>
 #include <ssynth/Model/Rendering/Renderer.h>
 #include <ssynth/Vector3.h>
 
@@ -34,7 +36,13 @@ struct ObjGroup
   std::vector<std::vector<VertexNormal>> faces;
 
   void addGroup(ObjGroup g);
-  void reduceVertices();
+  /// Adds the primitives of 'g', with its vertices transformed by 'm'.
+  void addGroup(const ObjGroup& g, const Math::AffineMatrix4f& m);
+
+  /// Merges the vertices closer than 'epsilon' (in every coordinate).
+  /// With 'epsilon' = 0 only identical vertices are merged. Identical normals are merged
+  /// as well. The first occurrence of a merged vertex is kept.
+  void reduceVertices(float epsilon = 0);
 };
 
 /// Obj file renderer
@@ -90,6 +98,12 @@ public:
 
   virtual void callGeneric(PrimitiveClass*){};
 
+  /// Tessellates the primitives directly, and only looks up the group when the class
+  /// (or the color, with 'groupByColor') changes.
+  virtual void drawPrimitives(
+      std::span<const PrimitiveRecord> primitives,
+      std::span<const MeshRecord> meshes);
+
   // Color
   // RGB in [0;1] intervals.
   virtual void setColor(Vector3f rgb) { this->rgb = rgb; }
@@ -113,17 +127,71 @@ public:
   void addLineQuad(ObjGroup& group, Vector3f v1, Vector3f v2, Vector3f v3, Vector3f v4);
   void setClass(const QString& classID, Vector3f rgb, double alpha);
 
+  /// Vertices closer than 'epsilon' are merged (see ObjGroup::reduceVertices).
+  /// By default the vertices of each primitive are merged when it is drawn, with
+  /// 'wholeGroups' the vertices of all primitives in a group are merged when written.
+  void setVertexWelding(float epsilon, bool wholeGroups)
+  {
+    weldEpsilon = epsilon;
+    weldGroups = wholeGroups;
+  }
+
+  /// While a writer is set, a group is written to it (and cleared) once it holds
+  /// 'chunkVertices' vertices, so the scene can be written while it is being built.
+  /// A group may then appear several times in the file, and the 'wholeGroups' welding
+  /// only merges vertices within each written part. Call 'write' at the end.
+  void setStreamWriter(ObjWriter* writer, int chunkVertices = 1 << 16)
+  {
+    streamWriter = writer;
+    streamChunkVertices = chunkVertices;
+  }
+
+  /// Writes the groups (which were not already streamed) to 'writer', and clears them.
+  void write(ObjWriter& writer);
   void writeToStream(QTextStream& ts);
 
-private:
-  std::map<QString, ObjGroup> groups;
+protected:
+  /// Adds a drawn primitive (using 1-based indices) to the current group.
+  virtual void addPrimitive(ObjGroup& primitive);
+  /// Adds a copy of 'mesh' transformed by 'm' to the current group.
+  virtual void addInstance(const ObjGroup& mesh, const Math::AffineMatrix4f& m);
+
   QString currentGroup;
   Math::Vector3f rgb;
   double alpha;
+
+private:
+  // The draw methods, in the current group.
+  void addBox(Vector3f base, Vector3f dir1, Vector3f dir2, Vector3f dir3);
+  void addMesh(
+      Vector3f startBase,
+      Vector3f startDir1,
+      Vector3f startDir2,
+      Vector3f endBase,
+      Vector3f endDir1,
+      Vector3f endDir2);
+  void addGrid(Vector3f base, Vector3f dir1, Vector3f dir2, Vector3f dir3);
+  void addLine(Vector3f from, Vector3f to);
+  void addDot(Vector3f pos);
+  void addSphere(Vector3f center, float radius);
+  void addTriangle(Vector3f p1, Vector3f p2, Vector3f p3);
+
+  /// Writes the current group to the stream writer if it is full.
+  void streamFullGroup();
+  void reducePrimitive(ObjGroup& group) const;
+  void writeGroup(ObjWriter& writer, ObjGroup& group);
+
+  std::map<QString, ObjGroup> groups;
+  ObjGroup unitSphere;       // Tessellated by the first sphere.
+  ObjGroup weldedUnitSphere; // 'unitSphere' with its identical vertices merged.
   int sphereDT;
   int sphereDP;
   bool groupByTagging;
   bool groupByColor;
+  float weldEpsilon{0};
+  bool weldGroups{false};
+  ObjWriter* streamWriter{};
+  int streamChunkVertices{};
 };
 
 }
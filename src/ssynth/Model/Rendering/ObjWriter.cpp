@@ -0,0 +1,148 @@
+#include <ssynth/FileUtils.h>
+#include <ssynth/Model/Rendering/ObjRenderer.h>
+#include <ssynth/Model/Rendering/ObjWriter.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace ssynth
+{
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+namespace
+{
+// Enough for "vn", three floats (in the '%g' form) and the separators.
+constexpr std::size_t MaxVectorLine = 2 + 3 * (1 + 16) + 2;
+// Enough for "v//n ".
+constexpr std::size_t MaxIndex = 2 * 11 + 3;
+
+char* writeFloat(char* out, float f)
+{
+  // Same as QString::number: '%g' with 6 significant digits.
+  return std::to_chars(out, out + 16, double(f), std::chars_format::general, 6).ptr;
+}
+}
+
+ObjWriter::ObjWriter(int fd, std::size_t bufferSize)
+    : ObjWriter(
+        [fd](const char* data, std::size_t size)
+        { Misc::FileUtils::writeAll(fd, data, size); },
+        bufferSize)
+{
+}
+
+ObjWriter::ObjWriter(Sink sink, std::size_t bufferSize)
+    : sink(std::move(sink))
+    , buffer(std::max(bufferSize, std::size_t(4096)))
+{
+}
+
+ObjWriter::~ObjWriter()
+{
+  // Errors can only be reported by an explicit 'flush'.
+  try
+  {
+    flush();
+  }
+  catch (...)
+  {
+  }
+}
+
+void ObjWriter::flush()
+{
+  if (used == 0)
+    return;
+  const std::size_t size = used;
+  used = 0;
+  sink(buffer.data(), size);
+}
+
+auto ObjWriter::reserve(std::size_t size) -> char*
+{
+  if (buffer.size() - used < size)
+  {
+    flush();
+    if (buffer.size() < size)
+      buffer.resize(size);
+  }
+  return buffer.data() + used;
+}
+
+void ObjWriter::writeVector(const char* prefix, Vector3f v)
+{
+  char* out = reserve(MaxVectorLine);
+  const std::size_t prefixLength = strlen(prefix);
+  memcpy(out, prefix, prefixLength);
+  out += prefixLength;
+  for (int i = 0; i < 3; i++)
+  {
+    *out++ = ' ';
+    out = writeFloat(out, v[i]);
+  }
+  *out++ = ' ';
+  *out++ = '\n';
+  used = out - buffer.data();
+}
+
+void ObjWriter::writeGroup(const ObjGroup& group)
+{
+  if (group.vertices.empty() && group.faces.empty())
+    return;
+
+  // Group name
+  const QByteArray name = group.groupName.toUtf8();
+  char* out = reserve(2 * name.size() + 12);
+  for (const char* header : {"g ", "usemtl "})
+  {
+    const std::size_t length = strlen(header);
+    memcpy(out, header, length);
+    memcpy(out + length, name.data(), name.size());
+    out += length + name.size();
+    *out++ = '\n';
+  }
+  used = out - buffer.data();
+
+  for (Vector3f v : group.vertices)
+  {
+    writeVector("v", v);
+  }
+  for (Vector3f v : group.normals)
+  {
+    writeVector("vn", v);
+  }
+
+  for (const std::vector<VertexNormal>& face : group.faces)
+  {
+    out = reserve(3);
+    *out++ = face.size() == 1 ? 'p' : face.size() == 2 ? 'l' : 'f';
+    *out++ = ' ';
+    used = out - buffer.data();
+    for (VertexNormal vn : face)
+    {
+      out = reserve(MaxIndex);
+      out = std::to_chars(out, out + 11, vn.vID + vertexCount).ptr;
+      if (vn.nID != -1)
+      {
+        *out++ = '/';
+        *out++ = '/';
+        out = std::to_chars(out, out + 11, vn.nID + normalCount).ptr;
+      }
+      *out++ = ' ';
+      used = out - buffer.data();
+    }
+    out = reserve(1);
+    *out++ = '\n';
+    used = out - buffer.data();
+  }
+
+  vertexCount += group.vertices.size();
+  normalCount += group.normals.size();
+}
+
+}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ssynth/Vector3.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+struct ObjGroup; // forward decl.
+
+/// Writes ObjGroup's in the Wavefront OBJ format.
+///
+/// The text is formatted (with std::to_chars) into a reusable buffer, which is only
+/// handed to the output when it is full and when 'flush' is called.
+/// The vertex and normal indices are numbered across all the groups written, so a
+/// group may be written in several parts (see ObjRenderer::setStreamWriter).
+class ObjWriter
+{
+public:
+  using Sink = std::function<void(const char* data, std::size_t size)>;
+
+  /// Writes to the file descriptor 'fd' (which is not closed).
+  explicit ObjWriter(int fd, std::size_t bufferSize = DefaultBufferSize);
+  /// Writes through 'sink'.
+  explicit ObjWriter(Sink sink, std::size_t bufferSize = DefaultBufferSize);
+  ~ObjWriter();
+
+  ObjWriter(const ObjWriter&) = delete;
+  ObjWriter& operator=(const ObjWriter&) = delete;
+
+  /// Writes the vertices, normals and faces of 'group' (nothing for an empty group).
+  void writeGroup(const ObjGroup& group);
+
+  /// Hands the buffered text to the output.
+  void flush();
+
+  static constexpr std::size_t DefaultBufferSize = 1 << 20;
+
+private:
+  /// Returns room for at least 'size' characters at the end of the buffer.
+  char* reserve(std::size_t size);
+  void writeVector(const char* prefix, Math::Vector3f v);
+
+  Sink sink;
+  std::vector<char> buffer;
+  std::size_t used{0};
+  int vertexCount{0};
+  int normalCount{0};
+};
+
+}
+}
+}
@@ -0,0 +1,246 @@
+#include <ssynth/Model/Rendering/PipelinedRenderer.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace ssynth
+{
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+PipelinedRenderer::PipelinedRenderer(Renderer* target, int queueBatches)
+    : target(target)
+    , slots(std::max(queueBatches, 1))
+{
+  consumer = std::thread([this] { consumerLoop(); });
+}
+
+PipelinedRenderer::~PipelinedRenderer()
+{
+  acquireSlot().quit = true;
+  publishSlot();
+  consumer.join();
+}
+
+auto PipelinedRenderer::acquireSlot() -> Slot&
+{
+  const uint64_t t = tail.load(std::memory_order_relaxed);
+  for (uint64_t h = head.load(std::memory_order_acquire); t - h == slots.size();
+       h = head.load(std::memory_order_acquire))
+  {
+    head.wait(h, std::memory_order_acquire);
+  }
+  return slots[t % slots.size()];
+}
+
+void PipelinedRenderer::publishSlot()
+{
+  tail.fetch_add(1, std::memory_order_release);
+  tail.notify_one();
+}
+
+void PipelinedRenderer::consumerLoop()
+{
+  for (uint64_t h = 0;; h++)
+  {
+    for (uint64_t t = tail.load(std::memory_order_acquire); t == h;
+         t = tail.load(std::memory_order_acquire))
+    {
+      tail.wait(t, std::memory_order_acquire);
+    }
+
+    Slot& slot = slots[h % slots.size()];
+    if (slot.quit)
+      return;
+    if (!error)
+    {
+      try
+      {
+        target->drawPrimitives(slot.primitives, slot.meshes);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+    }
+    head.store(h + 1, std::memory_order_release);
+    head.notify_one();
+  }
+}
+
+void PipelinedRenderer::sync()
+{
+  const uint64_t t = tail.load(std::memory_order_relaxed);
+  for (uint64_t h = head.load(std::memory_order_acquire); h != t;
+       h = head.load(std::memory_order_acquire))
+  {
+    head.wait(h, std::memory_order_acquire);
+  }
+  if (error)
+    std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void PipelinedRenderer::drawPrimitives(
+    std::span<const PrimitiveRecord> primitives,
+    std::span<const MeshRecord> meshes)
+{
+  if (primitives.empty())
+    return;
+  Slot& slot = acquireSlot();
+  // The slot vectors keep their capacity, so the queue allocates nothing once warm.
+  slot.primitives.assign(primitives.begin(), primitives.end());
+  slot.meshes.assign(meshes.begin(), meshes.end());
+  publishSlot();
+}
+
+void PipelinedRenderer::begin()
+{
+  sync();
+  target->begin();
+}
+
+void PipelinedRenderer::end()
+{
+  sync();
+  target->end();
+}
+
+void PipelinedRenderer::drawBox(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  sync();
+  target->drawBox(base, dir1, dir2, dir3, classID);
+}
+
+void PipelinedRenderer::drawMesh(
+    Vector3f startBase,
+    Vector3f startDir1,
+    Vector3f startDir2,
+    Vector3f endBase,
+    Vector3f endDir1,
+    Vector3f endDir2,
+    PrimitiveClass* classID)
+{
+  sync();
+  target->drawMesh(startBase, startDir1, startDir2, endBase, endDir1, endDir2, classID);
+}
+
+void PipelinedRenderer::drawGrid(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  sync();
+  target->drawGrid(base, dir1, dir2, dir3, classID);
+}
+
+void PipelinedRenderer::drawLine(Vector3f from, Vector3f to, PrimitiveClass* classID)
+{
+  sync();
+  target->drawLine(from, to, classID);
+}
+
+void PipelinedRenderer::drawDot(Vector3f pos, PrimitiveClass* classID)
+{
+  sync();
+  target->drawDot(pos, classID);
+}
+
+void PipelinedRenderer::drawSphere(Vector3f center, float radius, PrimitiveClass* classID)
+{
+  sync();
+  target->drawSphere(center, radius, classID);
+}
+
+void PipelinedRenderer::drawTriangle(
+    Vector3f p1,
+    Vector3f p2,
+    Vector3f p3,
+    PrimitiveClass* classID)
+{
+  sync();
+  target->drawTriangle(p1, p2, p3, classID);
+}
+
+void PipelinedRenderer::callGeneric(PrimitiveClass* classID)
+{
+  sync();
+  target->callGeneric(classID);
+}
+
+void PipelinedRenderer::setColor(Vector3f rgb)
+{
+  sync();
+  target->setColor(rgb);
+}
+
+void PipelinedRenderer::setBackgroundColor(Vector3f rgb)
+{
+  sync();
+  target->setBackgroundColor(rgb);
+}
+
+void PipelinedRenderer::setAlpha(double alpha)
+{
+  sync();
+  target->setAlpha(alpha);
+}
+
+void PipelinedRenderer::setPreviousColor(Vector3f rgb)
+{
+  sync();
+  target->setPreviousColor(rgb);
+}
+
+void PipelinedRenderer::setPreviousAlpha(double alpha)
+{
+  sync();
+  target->setPreviousAlpha(alpha);
+}
+
+void PipelinedRenderer::setTranslation(Vector3f translation)
+{
+  sync();
+  target->setTranslation(translation);
+}
+
+void PipelinedRenderer::setScale(double scale)
+{
+  sync();
+  target->setScale(scale);
+}
+
+void PipelinedRenderer::setRotation(Matrix4f rotation)
+{
+  sync();
+  target->setRotation(rotation);
+}
+
+void PipelinedRenderer::setPivot(Vector3f pivot)
+{
+  sync();
+  target->setPivot(pivot);
+}
+
+void PipelinedRenderer::setPerspectiveAngle(double angle)
+{
+  sync();
+  target->setPerspectiveAngle(angle);
+}
+
+void PipelinedRenderer::callCommand(const QString& renderClass, const QString& command)
+{
+  sync();
+  target->callCommand(renderClass, command);
+}
+
+}
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/Renderer.h>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// A renderer forwarding the primitive batches to another renderer on a consumer
+/// thread, so the structure can be built while the target tessellates, formats and
+/// writes the previous primitives.
+///
+/// The batches go through a bounded single-producer single-consumer ring (the builder
+/// thread produces, the target is only ever called by one thread at a time): when
+/// 'queueBatches' batches are pending, the producer blocks until one is consumed.
+/// All other calls wait for the queue to be drained, and are forwarded directly.
+///
+/// If the target throws, the following batches are dropped, and the exception is
+/// rethrown by the next call other than 'drawPrimitives' (at the latest by 'sync').
+class PipelinedRenderer : public Renderer
+{
+public:
+  explicit PipelinedRenderer(Renderer* target, int queueBatches = 16);
+  virtual ~PipelinedRenderer();
+
+  PipelinedRenderer(const PipelinedRenderer&) = delete;
+  PipelinedRenderer& operator=(const PipelinedRenderer&) = delete;
+
+  /// Waits until the target has drawn all queued primitives.
+  void sync();
+
+  /// Flow
+  virtual void begin();
+  virtual void end();
+
+  virtual QString renderClass() { return target->renderClass(); }
+
+  virtual void drawPrimitives(
+      std::span<const PrimitiveRecord> primitives,
+      std::span<const MeshRecord> meshes);
+
+  /// The primitives
+  virtual void drawBox(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawMesh(
+      Math::Vector3f startBase,
+      Math::Vector3f startDir1,
+      Math::Vector3f startDir2,
+      Math::Vector3f endBase,
+      Math::Vector3f endDir1,
+      Math::Vector3f endDir2,
+      PrimitiveClass* classID);
+
+  virtual void drawGrid(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawLine(Math::Vector3f from, Math::Vector3f to, PrimitiveClass* classID);
+
+  virtual void drawDot(Math::Vector3f pos, PrimitiveClass* classID);
+
+  virtual void drawSphere(Math::Vector3f center, float radius, PrimitiveClass* classID);
+
+  virtual void drawTriangle(
+      Math::Vector3f p1,
+      Math::Vector3f p2,
+      Math::Vector3f p3,
+      PrimitiveClass* classID);
+
+  virtual void callGeneric(PrimitiveClass* classID);
+
+  // Color
+  virtual void setColor(Math::Vector3f rgb);
+  virtual void setBackgroundColor(Math::Vector3f rgb);
+  virtual void setAlpha(double alpha);
+
+  virtual void setPreviousColor(Math::Vector3f rgb);
+  virtual void setPreviousAlpha(double alpha);
+
+  // Camera settings
+  virtual void setTranslation(Math::Vector3f translation);
+  virtual void setScale(double scale);
+  virtual void setRotation(Math::Matrix4f rotation);
+  virtual void setPivot(Math::Vector3f pivot);
+  virtual void setPerspectiveAngle(double angle);
+
+  virtual void callCommand(const QString& renderClass, const QString& command);
+
+private:
+  struct Slot
+  {
+    std::vector<PrimitiveRecord> primitives;
+    std::vector<MeshRecord> meshes;
+    bool quit{};
+  };
+
+  /// Waits for a free slot and returns it (only called by the producer).
+  Slot& acquireSlot();
+  /// Makes the slot returned by 'acquireSlot' available to the consumer.
+  void publishSlot();
+  void consumerLoop();
+
+  Renderer* target;
+  std::vector<Slot> slots;
+  // Monotonic slot counters: 'head' is only written by the consumer, 'tail' only by
+  // the producer. Slot i is stored at 'slots[i % slots.size()]'.
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> tail{0};
+  std::exception_ptr error; // Written by the consumer before it advances 'head'.
+  std::thread consumer;
+};
+
+}
+}
+}
@@ -0,0 +1,147 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Model/Rendering/PlyRenderer.h>
+
+#include <cstring>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+namespace
+{
+// The element counts are written with this width, so they can be updated in place.
+constexpr int CountWidth = 10;
+
+uint8_t colorComponent(double c)
+{
+  return uint8_t(std::clamp(c, 0.0, 1.0) * 255 + 0.5);
+}
+}
+
+PlyRenderer::~PlyRenderer()
+{
+  if (faceFile)
+    fclose(faceFile);
+}
+
+void PlyRenderer::writeHeader()
+{
+  auto text = [this](const char* s) { put(file, s, strlen(s)); };
+  auto count = [&](const char* element)
+  {
+    text(element);
+    const long position = ftell(file);
+    text("0000000000\n");
+    return position;
+  };
+
+  text("ply\n"
+       "format binary_little_endian 1.0\n"
+       "comment Generated by Structure Synth\n");
+  vertexCountPosition = count("element vertex ");
+  text("property float x\n"
+       "property float y\n"
+       "property float z\n"
+       "property uchar red\n"
+       "property uchar green\n"
+       "property uchar blue\n"
+       "property uchar alpha\n");
+  faceCountPosition = count("element face ");
+  text("property list uchar uint vertex_indices\n"
+       "property uint group\n");
+  groupCountPosition = count("element group ");
+  text("property list uchar uchar name\n"
+       "end_header\n");
+
+  vertexCount = 0;
+  faceCount = 0;
+  if (faceFile)
+    fclose(faceFile);
+  faceFile = tmpfile();
+  if (!faceFile)
+    throw Exception("Unable to create a temporary file for the PLY faces.");
+  faceBuffer.resize(1 << 20);
+  setvbuf(faceFile, faceBuffer.data(), _IOFBF, faceBuffer.size());
+}
+
+void PlyRenderer::writePrimitive(
+    const std::vector<Vector3f>& vertices,
+    const std::vector<Triangle>& triangles,
+    int group)
+{
+  const uint8_t color[4] = {
+      colorComponent(rgb[0]),
+      colorComponent(rgb[1]),
+      colorComponent(rgb[2]),
+      colorComponent(alpha)};
+
+  record.clear();
+  for (Vector3f v : vertices)
+  {
+    append(record, v.x());
+    append(record, v.y());
+    append(record, v.z());
+    for (uint8_t c : color)
+      append(record, c);
+  }
+  put(file, record);
+
+  record.clear();
+  for (const Triangle& t : triangles)
+  {
+    append(record, uint8_t(3));
+    for (uint32_t index : t)
+      append(record, index + vertexCount);
+    append(record, uint32_t(group));
+  }
+  put(faceFile, record);
+
+  vertexCount += vertices.size();
+  faceCount += triangles.size();
+}
+
+void PlyRenderer::writeFooter()
+{
+  // Faces
+  if (fflush(faceFile) != 0 || fseek(faceFile, 0, SEEK_SET) != 0)
+    throw Exception("Unable to read the temporary PLY face file.");
+  std::vector<char> chunk(1 << 16);
+  std::size_t size;
+  while ((size = fread(chunk.data(), 1, chunk.size(), faceFile)) > 0)
+  {
+    put(file, chunk.data(), size);
+  }
+  fclose(faceFile);
+  faceFile = nullptr;
+
+  // Group names (truncated to 255 bytes)
+  record.clear();
+  for (const QString& name : groupNames)
+  {
+    const QByteArray utf8 = name.toUtf8();
+    const int length = std::min<int>(utf8.size(), 255);
+    append(record, uint8_t(length));
+    record.insert(record.end(), utf8.data(), utf8.data() + length);
+  }
+  put(file, record);
+
+  writeCount(vertexCountPosition, vertexCount);
+  writeCount(faceCountPosition, faceCount);
+  writeCount(groupCountPosition, groupNames.size());
+}
+
+void PlyRenderer::writeCount(long position, uint32_t count)
+{
+  char digits[CountWidth + 1];
+  snprintf(digits, sizeof(digits), "%0*u", CountWidth, (unsigned)count);
+  if (fseek(file, position, SEEK_SET) != 0)
+    throw Exception("Unable to update the PLY header.");
+  put(file, digits, CountWidth);
+}
+
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/BinaryMeshRenderer.h>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// Binary (little-endian) PLY file renderer.
+///
+/// The vertices have an RGBA color (from 'setColor' and 'setAlpha'), the faces are
+/// triangles with the index of their group, and the group names are stored in a last
+/// 'group' element.
+///
+/// The element counts are only known at the end, so they are written as fixed-width
+/// numbers and updated by 'end'; the faces are kept in a temporary file until then.
+class PlyRenderer : public BinaryMeshRenderer
+{
+public:
+  PlyRenderer(
+      const QString& fileName,
+      int sphereDT,
+      int sphereDP,
+      bool groupByTagging,
+      bool groupByColor)
+      : BinaryMeshRenderer(fileName, sphereDT, sphereDP, groupByTagging, groupByColor){};
+  virtual ~PlyRenderer();
+
+  virtual QString renderClass() { return "PlyRenderer"; }
+
+protected:
+  virtual void writeHeader();
+  virtual void writePrimitive(
+      const std::vector<Math::Vector3f>& vertices,
+      const std::vector<Triangle>& triangles,
+      int group);
+  virtual void writeFooter();
+
+private:
+  /// Writes a count at 'position' (see 'writeHeader').
+  void writeCount(long position, uint32_t count);
+
+  std::FILE* faceFile{};
+  std::vector<char> faceBuffer;
+  std::vector<char> record;
+  long vertexCountPosition{};
+  long faceCountPosition{};
+  long groupCountPosition{};
+  uint32_t vertexCount{};
+  uint32_t faceCount{};
+};
+
+}
+}
+}
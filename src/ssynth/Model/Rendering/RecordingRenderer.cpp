@@ -0,0 +1,258 @@
+#include <ssynth/Model/Rendering/RecordingRenderer.h>
+
+namespace ssynth
+{
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+auto RecordingRenderer::record(CallType type, PrimitiveClass* classID, double scalar)
+    -> Call&
+{
+  Call& c = calls.emplace_back();
+  c.type = type;
+  c.classID = classID;
+  c.scalar = scalar;
+  return c;
+}
+
+void RecordingRenderer::drawBox(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  Call& c = record(Box, classID);
+  c.v[0] = base;
+  c.v[1] = dir1;
+  c.v[2] = dir2;
+  c.v[3] = dir3;
+}
+
+void RecordingRenderer::drawMesh(
+    Vector3f startBase,
+    Vector3f startDir1,
+    Vector3f startDir2,
+    Vector3f endBase,
+    Vector3f endDir1,
+    Vector3f endDir2,
+    PrimitiveClass* classID)
+{
+  Call& c = record(Mesh, classID);
+  c.v[0] = startBase;
+  c.v[1] = startDir1;
+  c.v[2] = startDir2;
+  c.v[3] = endBase;
+  c.v[4] = endDir1;
+  c.v[5] = endDir2;
+}
+
+void RecordingRenderer::drawGrid(
+    Vector3f base,
+    Vector3f dir1,
+    Vector3f dir2,
+    Vector3f dir3,
+    PrimitiveClass* classID)
+{
+  Call& c = record(Grid, classID);
+  c.v[0] = base;
+  c.v[1] = dir1;
+  c.v[2] = dir2;
+  c.v[3] = dir3;
+}
+
+void RecordingRenderer::drawLine(Vector3f from, Vector3f to, PrimitiveClass* classID)
+{
+  Call& c = record(Line, classID);
+  c.v[0] = from;
+  c.v[1] = to;
+}
+
+void RecordingRenderer::drawDot(Vector3f pos, PrimitiveClass* classID)
+{
+  record(Dot, classID).v[0] = pos;
+}
+
+void RecordingRenderer::drawSphere(
+    Vector3f center,
+    float radius,
+    PrimitiveClass* classID)
+{
+  record(Sphere, classID, radius).v[0] = center;
+}
+
+void RecordingRenderer::drawTriangle(
+    Vector3f p1,
+    Vector3f p2,
+    Vector3f p3,
+    PrimitiveClass* classID)
+{
+  Call& c = record(Triangle, classID);
+  c.v[0] = p1;
+  c.v[1] = p2;
+  c.v[2] = p3;
+}
+
+void RecordingRenderer::callGeneric(PrimitiveClass* classID)
+{
+  record(Generic, classID);
+}
+
+void RecordingRenderer::drawPrimitives(
+    std::span<const PrimitiveRecord> primitives,
+    std::span<const MeshRecord> meshes)
+{
+  record(Primitives, nullptr, batches.size());
+  batches.push_back(Batch{
+      this->primitives.size(), primitives.size(), this->meshes.size(), meshes.size()});
+  this->primitives.insert(this->primitives.end(), primitives.begin(), primitives.end());
+  this->meshes.insert(this->meshes.end(), meshes.begin(), meshes.end());
+}
+
+void RecordingRenderer::setColor(Vector3f rgb)
+{
+  record(Color).v[0] = rgb;
+}
+
+void RecordingRenderer::setBackgroundColor(Vector3f rgb)
+{
+  record(BackgroundColor).v[0] = rgb;
+}
+
+void RecordingRenderer::setAlpha(double alpha)
+{
+  record(Alpha, nullptr, alpha);
+}
+
+void RecordingRenderer::setPreviousColor(Vector3f rgb)
+{
+  record(PreviousColor).v[0] = rgb;
+}
+
+void RecordingRenderer::setPreviousAlpha(double alpha)
+{
+  record(PreviousAlpha, nullptr, alpha);
+}
+
+void RecordingRenderer::setTranslation(Vector3f translation)
+{
+  record(Translation).v[0] = translation;
+}
+
+void RecordingRenderer::setScale(double scale)
+{
+  record(Scale, nullptr, scale);
+}
+
+void RecordingRenderer::setRotation(Matrix4f rotation)
+{
+  record(Rotation, nullptr, rotations.size());
+  rotations.push_back(rotation);
+}
+
+void RecordingRenderer::setPivot(Vector3f pivot)
+{
+  record(Pivot).v[0] = pivot;
+}
+
+void RecordingRenderer::setPerspectiveAngle(double angle)
+{
+  record(PerspectiveAngle, nullptr, angle);
+}
+
+void RecordingRenderer::callCommand(const QString& renderClass, const QString& command)
+{
+  record(Command, nullptr, commands.size());
+  commands.emplace_back(renderClass, command);
+}
+
+void RecordingRenderer::replay(Renderer* r) const
+{
+  for (const Call& c : calls)
+  {
+    switch (c.type)
+    {
+      case Box:
+        r->drawBox(c.v[0], c.v[1], c.v[2], c.v[3], c.classID);
+        break;
+      case Mesh:
+        r->drawMesh(c.v[0], c.v[1], c.v[2], c.v[3], c.v[4], c.v[5], c.classID);
+        break;
+      case Grid:
+        r->drawGrid(c.v[0], c.v[1], c.v[2], c.v[3], c.classID);
+        break;
+      case Line:
+        r->drawLine(c.v[0], c.v[1], c.classID);
+        break;
+      case Dot:
+        r->drawDot(c.v[0], c.classID);
+        break;
+      case Sphere:
+        r->drawSphere(c.v[0], c.scalar, c.classID);
+        break;
+      case Triangle:
+        r->drawTriangle(c.v[0], c.v[1], c.v[2], c.classID);
+        break;
+      case Generic:
+        r->callGeneric(c.classID);
+        break;
+      case Primitives:
+      {
+        // The mesh indices are relative to the meshes of their batch.
+        const Batch& batch = batches[(int)c.scalar];
+        r->drawPrimitives(
+            std::span(primitives).subspan(batch.offset, batch.size),
+            std::span(meshes).subspan(batch.meshOffset, batch.meshCount));
+        break;
+      }
+      case Color:
+        r->setColor(c.v[0]);
+        break;
+      case BackgroundColor:
+        r->setBackgroundColor(c.v[0]);
+        break;
+      case Alpha:
+        r->setAlpha(c.scalar);
+        break;
+      case PreviousColor:
+        r->setPreviousColor(c.v[0]);
+        break;
+      case PreviousAlpha:
+        r->setPreviousAlpha(c.scalar);
+        break;
+      case Translation:
+        r->setTranslation(c.v[0]);
+        break;
+      case Scale:
+        r->setScale(c.scalar);
+        break;
+      case Rotation:
+        r->setRotation(rotations[(int)c.scalar]);
+        break;
+      case Pivot:
+        r->setPivot(c.v[0]);
+        break;
+      case PerspectiveAngle:
+        r->setPerspectiveAngle(c.scalar);
+        break;
+      case Command:
+        r->callCommand(commands[(int)c.scalar].first, commands[(int)c.scalar].second);
+        break;
+    }
+  }
+}
+
+void RecordingRenderer::clear()
+{
+  calls.clear();
+  rotations.clear();
+  commands.clear();
+  primitives.clear();
+  meshes.clear();
+  batches.clear();
+}
+
+}
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <ssynth/Matrix4.h>
+#include <ssynth/Model/Rendering/Renderer.h>
+#include <ssynth/Vector3.h>
+
+#include <QString>
+
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// A renderer which stores all calls made to it, so they can be replayed later on
+/// another renderer, in the same order.
+///
+/// Used by the parallel generation executor: every worker renders into its own
+/// RecordingRenderer, and the recordings are replayed on the real render target
+/// in the original stack order.
+class RecordingRenderer : public Renderer
+{
+public:
+  /// 'target' is only used for answering 'renderClass()'.
+  RecordingRenderer(Renderer* target = nullptr)
+      : target(target){};
+  virtual ~RecordingRenderer(){};
+
+  virtual QString renderClass() { return target ? target->renderClass() : QString(); }
+
+  /// The primitives
+  virtual void drawBox(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawMesh(
+      Math::Vector3f startBase,
+      Math::Vector3f startDir1,
+      Math::Vector3f startDir2,
+      Math::Vector3f endBase,
+      Math::Vector3f endDir1,
+      Math::Vector3f endDir2,
+      PrimitiveClass* classID);
+
+  virtual void drawGrid(
+      Math::Vector3f base,
+      Math::Vector3f dir1,
+      Math::Vector3f dir2,
+      Math::Vector3f dir3,
+      PrimitiveClass* classID);
+
+  virtual void drawLine(Math::Vector3f from, Math::Vector3f to, PrimitiveClass* classID);
+
+  virtual void drawDot(Math::Vector3f pos, PrimitiveClass* classID);
+
+  virtual void drawSphere(Math::Vector3f center, float radius, PrimitiveClass* classID);
+
+  virtual void drawTriangle(
+      Math::Vector3f p1,
+      Math::Vector3f p2,
+      Math::Vector3f p3,
+      PrimitiveClass* classID);
+
+  virtual void callGeneric(PrimitiveClass* classID);
+
+  virtual void drawPrimitives(
+      std::span<const PrimitiveRecord> primitives,
+      std::span<const MeshRecord> meshes);
+
+  // Color
+  virtual void setColor(Math::Vector3f rgb);
+  virtual void setBackgroundColor(Math::Vector3f rgb);
+  virtual void setAlpha(double alpha);
+
+  virtual void setPreviousColor(Math::Vector3f rgb);
+  virtual void setPreviousAlpha(double alpha);
+
+  // Camera settings
+  virtual void setTranslation(Math::Vector3f translation);
+  virtual void setScale(double scale);
+  virtual void setRotation(Math::Matrix4f rotation);
+  virtual void setPivot(Math::Vector3f pivot);
+  virtual void setPerspectiveAngle(double angle);
+
+  virtual void callCommand(const QString& renderClass, const QString& command);
+
+  /// Replays all recorded calls on 'renderer'.
+  void replay(Renderer* renderer) const;
+
+  /// Removes all recorded calls (keeps the allocated memory).
+  void clear();
+
+  bool isEmpty() const { return calls.empty(); }
+
+private:
+  enum CallType
+  {
+    Box,
+    Mesh,
+    Grid,
+    Line,
+    Dot,
+    Sphere,
+    Triangle,
+    Generic,
+    Primitives,
+    Color,
+    BackgroundColor,
+    Alpha,
+    PreviousColor,
+    PreviousAlpha,
+    Translation,
+    Scale,
+    Rotation,
+    Pivot,
+    PerspectiveAngle,
+    Command
+  };
+
+  struct Call
+  {
+    CallType type;
+    PrimitiveClass* classID;
+    // Alpha, radius, scale,... or an index into 'rotations', 'commands' or 'batches'.
+    double scalar;
+    Math::Vector3f v[6];
+  };
+
+  // A 'drawPrimitives' call: its ranges in 'primitives' and 'meshes'.
+  struct Batch
+  {
+    std::size_t offset;
+    std::size_t size;
+    std::size_t meshOffset;
+    std::size_t meshCount;
+  };
+
+  Call& record(CallType type, PrimitiveClass* classID = nullptr, double scalar = 0);
+
+  Renderer* target;
+  std::vector<Call> calls;
+  std::vector<Math::Matrix4f> rotations;
+  std::vector<std::pair<QString, QString>> commands;
+  std::vector<PrimitiveRecord> primitives;
+  std::vector<MeshRecord> meshes;
+  std::vector<Batch> batches;
+};
+
+}
+}
+}
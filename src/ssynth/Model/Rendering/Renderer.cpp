@@ -0,0 +1,70 @@
+#include <ssynth/Model/Rendering/Renderer.h>
+
+namespace ssynth
+{
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+void Renderer::drawPrimitives(
+    std::span<const PrimitiveRecord> primitives,
+    std::span<const MeshRecord> meshes)
+{
+  for (const PrimitiveRecord& p : primitives)
+  {
+    if (p.type == PrimitiveRecord::Generic)
+    {
+      callGeneric(p.classID);
+      continue;
+    }
+
+    setColor(Vector3f(p.rgba[0], p.rgba[1], p.rgba[2]));
+    setAlpha(p.rgba[3]);
+
+    const AffineMatrix4f& m = p.matrix;
+    switch (p.type)
+    {
+      case PrimitiveRecord::Box:
+        drawBox(p.base(), p.edge(0), p.edge(1), p.edge(2), p.classID);
+        break;
+      case PrimitiveRecord::Grid:
+        drawGrid(p.base(), p.edge(0), p.edge(1), p.edge(2), p.classID);
+        break;
+      case PrimitiveRecord::Sphere:
+        drawSphere(p.center(), p.radius(), p.classID);
+        break;
+      case PrimitiveRecord::Dot:
+        drawDot(p.center(), p.classID);
+        break;
+      case PrimitiveRecord::Line:
+        drawLine(m * Vector3f(0, 0.5, 0.5), m * Vector3f(1, 0.5, 0.5), p.classID);
+        break;
+      case PrimitiveRecord::Mesh:
+      {
+        const MeshRecord& start = meshes[p.mesh];
+        const Vector3f startBase = start.matrix.column(3);
+        setPreviousColor(Vector3f(start.rgba[0], start.rgba[1], start.rgba[2]));
+        setPreviousAlpha(start.rgba[3]);
+        drawMesh(
+            startBase,
+            roundedEdge(startBase, start.matrix.column(0)),
+            roundedEdge(startBase, start.matrix.column(1)),
+            p.base(),
+            p.edge(0),
+            p.edge(1),
+            p.classID);
+        break;
+      }
+      case PrimitiveRecord::Triangle:
+        drawTriangle(m.column(3), m.column(0), m.column(1), p.classID);
+        break;
+      case PrimitiveRecord::Color:
+      case PrimitiveRecord::Generic:
+        break;
+    }
+  }
+}
+
+}
+}
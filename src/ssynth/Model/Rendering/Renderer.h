@@ -1,11 +1,15 @@
 #pragma once
 
+#include <ssynth/AffineMatrix4.h>
 #include <ssynth/Matrix4.h>
 #include <ssynth/Model/PrimitiveClass.h>
 #include <ssynth/Vector3.h>
 
 #include <QString>
 
+#include <cstdint>
+#include <span>
+
 namespace ssynth
 {
 namespace Model
@@ -15,6 +19,65 @@ namespace Rendering
 
 // using namespace GLEngine;
 
+/// The edge 'dir' from 'base', rounded as the difference of the transformed corners
+/// (so that the sums of the base and edges computed by the renderers are consistent,
+/// and coincident corners are merged).
+inline Math::Vector3f roundedEdge(Math::Vector3f base, Math::Vector3f dir)
+{
+  return (base + dir) - base;
+}
+
+/// A primitive drawn by the Builder (see Renderer::drawPrimitives).
+///
+/// 'matrix' maps the unit primitive into the scene: the unit cube for boxes and grids,
+/// the sphere inscribed in the unit cube, the center of the unit cube for dots and the
+/// segment from (0,0.5,0.5) to (1,0.5,0.5) for lines. Meshes go from the bottom face
+/// of the unit cube mapped by their MeshRecord to the one mapped by 'matrix'. Triangles
+/// store their corners as they are: the first one in column 3 of 'matrix', the others
+/// in columns 0 and 1.
+struct PrimitiveRecord
+{
+  enum Type : uint8_t
+  {
+    Box,
+    Sphere,
+    Dot,
+    Grid,
+    Line,
+    Mesh,
+    Triangle,
+    Color,  // Only sets the color (for primitives that are not drawn, e.g. cylinders).
+    Generic // 'callGeneric' (the matrix and colors are not set).
+  };
+
+  Math::AffineMatrix4f matrix;
+  float rgba[4]; // RGB in [0;1] intervals.
+  PrimitiveClass* classID;
+  int mesh; // Meshes only: the index of their MeshRecord in the batch.
+  Type type;
+
+  Math::Vector3f base() const { return matrix.column(3); }
+  /// The image of unit axis 'axis' (see 'roundedEdge').
+  Math::Vector3f edge(int axis) const
+  {
+    return roundedEdge(base(), matrix.column(axis));
+  }
+  Math::Vector3f center() const { return matrix * Math::Vector3f(0.5, 0.5, 0.5); }
+  /// The distance from the center to the bottom face (computed as the Builder did).
+  float radius() const
+  {
+    return (center() - matrix * Math::Vector3f(0.5, 0.5, 0.0)).length();
+  }
+};
+
+/// The start of a mesh: the state before the one drawing it. Only meshes need it, so
+/// it is kept out of the PrimitiveRecords.
+struct MeshRecord
+{
+  Math::AffineMatrix4f matrix;
+  float rgba[4];
+};
+
 /// Abstract base class for implementing a renderer
 class Renderer
 {
@@ -73,6 +136,14 @@ public:
 
   virtual void callGeneric(PrimitiveClass*){};
 
+  /// Draws a batch of primitives, 'meshes' holds the MeshRecords of its meshes.
+  /// The Builder sends all its primitives through here. By default every primitive is
+  /// forwarded to 'setColor', 'setAlpha' and the draw method of its type, renderers
+  /// can override this to process whole batches.
+  virtual void drawPrimitives(
+      std::span<const PrimitiveRecord> primitives,
+      std::span<const MeshRecord> meshes);
+
   // Color
   // RGB in [0;1] intervals.
   virtual void setColor(Math::Vector3f rgb) = 0;
@@ -0,0 +1,75 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Logging.h>
+#include <ssynth/Model/Rendering/StlRenderer.h>
+
+#include <cstring>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Logging;
+using namespace Math;
+
+namespace Model::Rendering
+{
+
+namespace
+{
+constexpr long HeaderSize = 80;
+}
+
+void StlRenderer::writeHeader()
+{
+  // The header must not start with 'solid', which marks ASCII files.
+  char header[HeaderSize] = {};
+  strncpy(header, "Binary STL generated by Structure Synth", HeaderSize);
+  put(file, header, HeaderSize);
+  record.clear();
+  append(record, uint32_t(0));
+  put(file, record);
+  triangleCount = 0;
+}
+
+void StlRenderer::writePrimitive(
+    const std::vector<Vector3f>& vertices,
+    const std::vector<Triangle>& triangles,
+    int group)
+{
+  record.clear();
+  for (const Triangle& t : triangles)
+  {
+    const Vector3f& p1 = vertices[t[0]];
+    const Vector3f& p2 = vertices[t[1]];
+    const Vector3f& p3 = vertices[t[2]];
+    Vector3f normal = Vector3f::cross(p2 - p1, p3 - p1);
+    if (normal.sqrLength() > 0)
+      normal.normalize();
+
+    for (Vector3f v : {normal, p1, p2, p3})
+    {
+      append(record, v.x());
+      append(record, v.y());
+      append(record, v.z());
+    }
+    append(record, uint16_t(std::min(group, 0xffff)));
+  }
+  put(file, record);
+  triangleCount += triangles.size();
+}
+
+void StlRenderer::writeFooter()
+{
+  record.clear();
+  append(record, triangleCount);
+  if (fseek(file, HeaderSize, SEEK_SET) != 0)
+    throw Exception("Unable to update the STL triangle count.");
+  put(file, record);
+
+  for (int i = 0; i < groupNames.size(); i++)
+  {
+    INFO(QString("STL attribute %1: %2").arg(i).arg(groupNames[i]));
+  }
+}
+
+}
+}
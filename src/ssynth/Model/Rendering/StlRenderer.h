@@ -0,0 +1,46 @@
+#pragma once
+
+#include <ssynth/Model/Rendering/BinaryMeshRenderer.h>
+
+namespace ssynth
+{
+namespace Model
+{
+namespace Rendering
+{
+
+/// Binary STL file renderer.
+///
+/// STL has neither colors nor groups: the 'attribute byte count' of every triangle is
+/// set to the index of its group (in the order the groups were first drawn), and the
+/// group names are logged by 'end'. The triangle count is updated by 'end'.
+class StlRenderer : public BinaryMeshRenderer
+{
+public:
+  StlRenderer(
+      const QString& fileName,
+      int sphereDT,
+      int sphereDP,
+      bool groupByTagging,
+      bool groupByColor)
+      : BinaryMeshRenderer(fileName, sphereDT, sphereDP, groupByTagging, groupByColor){};
+  virtual ~StlRenderer(){};
+
+  virtual QString renderClass() { return "StlRenderer"; }
+
+protected:
+  virtual void writeHeader();
+  virtual void writePrimitive(
+      const std::vector<Math::Vector3f>& vertices,
+      const std::vector<Triangle>& triangles,
+      int group);
+  virtual void writeFooter();
+
+private:
+  std::vector<char> record;
+  uint32_t triangleCount{};
+};
+
+}
+}
+}
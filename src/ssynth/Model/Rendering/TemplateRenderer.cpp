@@ -1,4 +1,5 @@
 #include <ssynth/Exception.h>
+#include <ssynth/FileUtils.h>
 #include <ssynth/Logging.h>
 #include <ssynth/Model/PrimitiveClass.h>
 #include <ssynth/Model/Rendering/TemplateRenderer.h>
@@ -178,6 +179,75 @@ void Template::parse(QDomDocument& doc)
   }
 }
 
+namespace
+{
+const char* const placeholderNames[] = {
+    "matrix", "columnmatrix", "povmatrix", "r", "g", "b", "alpha", "oneminusalpha",
+    "uid", "p1x", "p1y", "p1z", "p2x", "p2y", "p2z", "p3x", "p3y", "p3z", "x1", "y1",
+    "z1", "x2", "y2", "z2", "x", "y", "z", "cx", "cy", "cz", "rad", "CamPosX",
+    "CamPosY", "CamPosZ", "CamUpX", "CamUpY", "CamUpZ", "CamDirX", "CamDirY", "CamDirZ",
+    "CamRightX", "CamRightY", "CamRightZ", "CamTargetX", "CamTargetY", "CamTargetZ",
+    "CamColumnMatrix", "aspect", "width", "height", "fov", "BR", "BG", "BB", "BR256",
+    "BG256", "BB256"};
+static_assert(std::size(placeholderNames) == int(TemplatePlaceholder::Count));
+
+/// Returns the placeholder named 'name' (without braces), or -1.
+int findPlaceholder(const QString& name)
+{
+  static const std::map<QString, int> placeholders = []
+  {
+    std::map<QString, int> m;
+    for (int i = 0; i < int(TemplatePlaceholder::Count); i++)
+      m[placeholderNames[i]] = i;
+    return m;
+  }();
+  auto it = placeholders.find(name);
+  return it != placeholders.end() ? it->second : -1;
+}
+}
+
+void TemplatePrimitive::compile()
+{
+  segments.clear();
+  placeholders.reset();
+
+  // The text up to 'literalStart' has been split into segments.
+  int literalStart = 0;
+  int open = def.indexOf('{');
+  while (open != -1)
+  {
+    const int close = def.indexOf('}', open + 1);
+    if (close == -1)
+      break;
+    const int placeholder = findPlaceholder(def.mid(open + 1, close - open - 1));
+    if (placeholder == -1)
+    {
+      // Not a placeholder: the brace is literal text.
+      open = def.indexOf('{', open + 1);
+      continue;
+    }
+    if (open > literalStart)
+      segments.push_back(Segment{def.mid(literalStart, open - literalStart)});
+    segments.push_back(Segment{def.mid(open, close - open + 1), placeholder});
+    placeholders.set(placeholder);
+    literalStart = close + 1;
+    open = def.indexOf('{', literalStart);
+  }
+  if (literalStart < def.size())
+    segments.push_back(Segment{def.mid(literalStart)});
+}
+
+void TemplatePrimitive::render(QString& out, const TemplateValues& values) const
+{
+  for (const Segment& segment : segments)
+  {
+    const QString* value = segment.placeholder == -1
+                               ? nullptr
+                               : values.get(TemplatePlaceholder(segment.placeholder));
+    out += value ? *value : segment.text;
+  }
+}
+
 TemplateRenderer::TemplateRenderer(const QString& xmlDefinitionFile)
     : counter(0)
 {
@@ -200,6 +270,14 @@ TemplateRenderer::TemplateRenderer()
 
 TemplateRenderer::~TemplateRenderer() = default;
 
+auto TemplateRenderer::findPrimitive(const QString& templateName)
+    -> const TemplatePrimitive*
+{
+  if (!assertPrimitiveExists(templateName))
+    return nullptr;
+  return workingTemplate.find(templateName);
+}
+
 auto TemplateRenderer::assertPrimitiveExists(const QString& templateName) -> bool
 {
   if (!workingTemplate.getPrimitives().contains(templateName))
@@ -221,32 +299,40 @@ auto TemplateRenderer::assertPrimitiveExists(const QString& templateName) -> boo
   return true;
 }
 
-void TemplateRenderer::doBeginEndSubstitutions(TemplatePrimitive& t)
+void TemplateRenderer::doBeginEndSubstitutions(const TemplatePrimitive& t)
 {
-  t.substitute("{CamPosX}", QString::number(cameraPosition.x()));
-  t.substitute("{CamPosY}", QString::number(cameraPosition.y()));
-  t.substitute("{CamPosZ}", QString::number(cameraPosition.z()));
+  using P = TemplatePlaceholder;
+  auto set = [&](P p, double value)
+  {
+    if (t.uses(p))
+      values.set(p, QString::number(value));
+  };
+  values.clear();
 
-  t.substitute("{CamUpX}", QString::number(cameraUp.x()));
-  t.substitute("{CamUpY}", QString::number(cameraUp.y()));
-  t.substitute("{CamUpZ}", QString::number(cameraUp.z()));
+  set(P::CamPosX, cameraPosition.x());
+  set(P::CamPosY, cameraPosition.y());
+  set(P::CamPosZ, cameraPosition.z());
+
+  set(P::CamUpX, cameraUp.x());
+  set(P::CamUpY, cameraUp.y());
+  set(P::CamUpZ, cameraUp.z());
 
   Vector3f cameraDir = cameraTarget - cameraPosition;
   cameraDir.normalize();
 
-  t.substitute("{CamDirX}", QString::number(cameraDir.x()));
-  t.substitute("{CamDirY}", QString::number(cameraDir.y()));
-  t.substitute("{CamDirZ}", QString::number(cameraDir.z()));
+  set(P::CamDirX, cameraDir.x());
+  set(P::CamDirY, cameraDir.y());
+  set(P::CamDirZ, cameraDir.z());
 
-  t.substitute("{CamRightX}", QString::number(cameraRight.x()));
-  t.substitute("{CamRightY}", QString::number(cameraRight.y()));
-  t.substitute("{CamRightZ}", QString::number(cameraRight.z()));
+  set(P::CamRightX, cameraRight.x());
+  set(P::CamRightY, cameraRight.y());
+  set(P::CamRightZ, cameraRight.z());
 
-  t.substitute("{CamTargetX}", QString::number(cameraTarget.x()));
-  t.substitute("{CamTargetY}", QString::number(cameraTarget.y()));
-  t.substitute("{CamTargetZ}", QString::number(cameraTarget.z()));
+  set(P::CamTargetX, cameraTarget.x());
+  set(P::CamTargetY, cameraTarget.y());
+  set(P::CamTargetZ, cameraTarget.z());
 
-  if (t.contains("{CamColumnMatrix}"))
+  if (t.uses(P::CamColumnMatrix))
   {
     const Vector3f u = -cameraRight;
     const Vector3f v = cameraUp;
@@ -266,21 +352,21 @@ void TemplateRenderer::doBeginEndSubstitutions(TemplatePrimitive& t)
                       .arg(w.z())
                       .arg(cameraPosition.z());
 
-    t.substitute("{CamColumnMatrix}", mat);
+    values.set(P::CamColumnMatrix, mat);
   }
 
-  t.substitute("{aspect}", QString::number(aspect));
-  t.substitute("{width}", QString::number(width));
-  t.substitute("{height}", QString::number(height));
-  t.substitute("{fov}", QString::number(fov));
+  set(P::aspect, aspect);
+  set(P::width, width);
+  set(P::height, height);
+  set(P::fov, fov);
 
-  t.substitute("{BR}", QString::number(backRgb.x()));
-  t.substitute("{BG}", QString::number(backRgb.y()));
-  t.substitute("{BB}", QString::number(backRgb.z()));
+  set(P::BR, backRgb.x());
+  set(P::BG, backRgb.y());
+  set(P::BB, backRgb.z());
 
-  t.substitute("{BR256}", QString::number(backRgb.x() * 255));
-  t.substitute("{BG256}", QString::number(backRgb.y() * 255));
-  t.substitute("{BB256}", QString::number(backRgb.z() * 255));
+  set(P::BR256, backRgb.x() * 255);
+  set(P::BG256, backRgb.y() * 255);
+  set(P::BB256, backRgb.z() * 255);
 }
 
 void TemplateRenderer::doStandardSubstitutions(
@@ -288,9 +374,10 @@ void TemplateRenderer::doStandardSubstitutions(
     Math::Vector3f dir1,
     Math::Vector3f dir2,
     Math::Vector3f dir3,
-    TemplatePrimitive& t)
+    const TemplatePrimitive& t)
 {
-  if (t.contains("{matrix}"))
+  using P = TemplatePlaceholder;
+  if (t.uses(P::matrix))
   {
     auto mats = fmt::format(
         "{} {} {} 0 {} {} {} 0 {} {} {} 0 {} {} {} 1",
@@ -306,10 +393,10 @@ void TemplateRenderer::doStandardSubstitutions(
         base.x(),
         base.y(),
         base.z());
-    t.substitute("{matrix}", QString::fromStdString(mats));
+    values.set(P::matrix, mats);
   }
 
-  if (t.contains("{columnmatrix}"))
+  if (t.uses(P::columnmatrix))
   {
     auto mats = fmt::format(
         "{} {} {} {} {} {} {} {} {} {} {} {} 0 0 0 1",
@@ -326,10 +413,10 @@ void TemplateRenderer::doStandardSubstitutions(
         dir3.z(),
         base.z());
 
-    t.substitute("{columnmatrix}", mats);
+    values.set(P::columnmatrix, mats);
   }
 
-  if (t.contains("{povmatrix}"))
+  if (t.uses(P::povmatrix))
   {
     auto mats = fmt::format(
         "{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}",
@@ -346,14 +433,25 @@ void TemplateRenderer::doStandardSubstitutions(
         base.y(),
         base.z());
 
-    t.substitute("{povmatrix}", mats);
+    values.set(P::povmatrix, mats);
   }
 
-  t.substitute("{r}", fmt::to_string(rgb.x()));
-  t.substitute("{g}", fmt::to_string(rgb.y()));
-  t.substitute("{b}", fmt::to_string(rgb.z()));
-  t.substitute("{alpha}", fmt::to_string(alpha));
-  t.substitute("{oneminusalpha}", fmt::to_string(1. - alpha));
+  auto set = [&](P p, auto value)
+  {
+    if (t.uses(p))
+      values.set(p, fmt::to_string(value));
+  };
+  set(P::r, rgb.x());
+  set(P::g, rgb.y());
+  set(P::b, rgb.z());
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1. - alpha);
+}
+
+void TemplateRenderer::render(const TemplatePrimitive& t)
+{
+  t.render(output, values);
+  flushIfFull();
 }
 
 void TemplateRenderer::drawBox(
@@ -363,20 +461,19 @@ void TemplateRenderer::drawBox(
     Math::Vector3f dir3,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-
-  if (!assertPrimitiveExists("box" + alternateID))
+  const TemplatePrimitive* t = findPrimitive("box" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("box" + alternateID));
 
-  doStandardSubstitutions(base, dir1, dir2, dir3, t);
+  values.clear();
+  doStandardSubstitutions(base, dir1, dir2, dir3, *t);
 
-  if (t.contains("{uid}"))
+  if (t->uses(TemplatePlaceholder::uid))
   {
-    t.substitute("{uid}", QString("Box%1").arg(counter++));
+    values.set(TemplatePlaceholder::uid, QString("Box%1").arg(counter++));
   }
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::drawTriangle(
@@ -385,30 +482,37 @@ void TemplateRenderer::drawTriangle(
     Math::Vector3f p3,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("triangle" + alternateID))
+  using P = TemplatePlaceholder;
+  const TemplatePrimitive* t = findPrimitive("triangle" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("triangle" + alternateID));
 
-  if (t.contains("{uid}"))
+  values.clear();
+  auto set = [&](P p, double value)
+  {
+    if (t->uses(p))
+      values.set(p, QString::number(value));
+  };
+
+  if (t->uses(P::uid))
   {
-    t.substitute("{uid}", QString("Triangle%1").arg(counter++));
+    values.set(P::uid, QString("Triangle%1").arg(counter++));
   }
 
-  t.substitute("{p1x}", QString::number(p1.x()));
-  t.substitute("{p1y}", QString::number(p1.y()));
-  t.substitute("{p1z}", QString::number(p1.z()));
-  t.substitute("{p2x}", QString::number(p2.x()));
-  t.substitute("{p2y}", QString::number(p2.y()));
-  t.substitute("{p2z}", QString::number(p2.z()));
-  t.substitute("{p3x}", QString::number(p3.x()));
-  t.substitute("{p3y}", QString::number(p3.y()));
-  t.substitute("{p3z}", QString::number(p3.z()));
+  set(P::p1x, p1.x());
+  set(P::p1y, p1.y());
+  set(P::p1z, p1.z());
+  set(P::p2x, p2.x());
+  set(P::p2y, p2.y());
+  set(P::p2z, p2.z());
+  set(P::p3x, p3.x());
+  set(P::p3y, p3.y());
+  set(P::p3z, p3.z());
 
-  t.substitute("{alpha}", QString::number(alpha));
-  t.substitute("{oneminusalpha}", QString::number(1 - alpha));
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1 - alpha);
 
-  output.push_back(t.getText());
+  render(*t);
 }
 
 void TemplateRenderer::drawGrid(
@@ -418,19 +522,19 @@ void TemplateRenderer::drawGrid(
     Math::Vector3f dir3,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("grid" + alternateID))
+  const TemplatePrimitive* t = findPrimitive("grid" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("grid" + alternateID));
 
-  doStandardSubstitutions(base, dir1, dir2, dir3, t);
+  values.clear();
+  doStandardSubstitutions(base, dir1, dir2, dir3, *t);
 
-  if (t.contains("{uid}"))
+  if (t->uses(TemplatePlaceholder::uid))
   {
-    t.substitute("{uid}", QString("Grid%1").arg(counter++));
+    values.set(TemplatePlaceholder::uid, QString("Grid%1").arg(counter++));
   }
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::drawLine(
@@ -438,52 +542,66 @@ void TemplateRenderer::drawLine(
     Math::Vector3f to,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("line" + alternateID))
+  using P = TemplatePlaceholder;
+  const TemplatePrimitive* t = findPrimitive("line" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("line" + alternateID));
-  t.substitute("{x1}", QString::number(from.x()));
-  t.substitute("{y1}", QString::number(from.y()));
-  t.substitute("{z1}", QString::number(from.z()));
 
-  t.substitute("{x2}", QString::number(to.x()));
-  t.substitute("{y2}", QString::number(to.y()));
-  t.substitute("{z2}", QString::number(to.z()));
+  values.clear();
+  auto set = [&](P p, double value)
+  {
+    if (t->uses(p))
+      values.set(p, QString::number(value));
+  };
+  set(P::x1, from.x());
+  set(P::y1, from.y());
+  set(P::z1, from.z());
 
-  t.substitute("{alpha}", QString::number(alpha));
-  t.substitute("{oneminusalpha}", QString::number(1 - alpha));
+  set(P::x2, to.x());
+  set(P::y2, to.y());
+  set(P::z2, to.z());
 
-  if (t.contains("{uid}"))
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1 - alpha);
+
+  if (t->uses(P::uid))
   {
-    t.substitute("{uid}", QString("Line%1").arg(counter++));
+    values.set(P::uid, QString("Line%1").arg(counter++));
   }
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::drawDot(Math::Vector3f v, PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("dot" + alternateID))
+  using P = TemplatePlaceholder;
+  const TemplatePrimitive* t = findPrimitive("dot" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("dot" + alternateID));
-  t.substitute("{x}", QString::number(v.x()));
-  t.substitute("{y}", QString::number(v.y()));
-  t.substitute("{z}", QString::number(v.z()));
 
-  t.substitute("{r}", QString::number(rgb.x()));
-  t.substitute("{g}", QString::number(rgb.y()));
-  t.substitute("{b}", QString::number(rgb.z()));
+  values.clear();
+  auto set = [&](P p, double value)
+  {
+    if (t->uses(p))
+      values.set(p, QString::number(value));
+  };
+  set(P::x, v.x());
+  set(P::y, v.y());
+  set(P::z, v.z());
+
+  set(P::r, rgb.x());
+  set(P::g, rgb.y());
+  set(P::b, rgb.z());
 
-  t.substitute("{alpha}", QString::number(alpha));
-  t.substitute("{oneminusalpha}", QString::number(1 - alpha));
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1 - alpha);
 
-  if (t.contains("{uid}"))
+  if (t->uses(P::uid))
   {
-    t.substitute("{uid}", QString("Dot%1").arg(counter++));
+    values.set(P::uid, QString("Dot%1").arg(counter++));
   }
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::drawSphere(
@@ -491,60 +609,68 @@ void TemplateRenderer::drawSphere(
     float radius,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("sphere" + alternateID))
+  using P = TemplatePlaceholder;
+  const TemplatePrimitive* t = findPrimitive("sphere" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("sphere" + alternateID));
-  t.substitute("{cx}", QString::number(center.x()));
-  t.substitute("{cy}", QString::number(center.y()));
-  t.substitute("{cz}", QString::number(center.z()));
 
-  t.substitute("{rad}", QString::number(radius));
+  values.clear();
+  auto set = [&](P p, double value)
+  {
+    if (t->uses(p))
+      values.set(p, QString::number(value));
+  };
+  set(P::cx, center.x());
+  set(P::cy, center.y());
+  set(P::cz, center.z());
+
+  set(P::rad, radius);
 
-  t.substitute("{r}", QString::number(rgb.x()));
-  t.substitute("{g}", QString::number(rgb.y()));
-  t.substitute("{b}", QString::number(rgb.z()));
+  set(P::r, rgb.x());
+  set(P::g, rgb.y());
+  set(P::b, rgb.z());
 
-  t.substitute("{alpha}", QString::number(alpha));
-  t.substitute("{oneminusalpha}", QString::number(1 - alpha));
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1 - alpha);
 
-  if (t.contains("{uid}"))
+  if (t->uses(P::uid))
   {
-    t.substitute("{uid}", QString("Sphere%1").arg(counter++));
+    values.set(P::uid, QString("Sphere%1").arg(counter++));
   }
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::begin()
 {
-  if (!assertPrimitiveExists("begin"))
+  const TemplatePrimitive* t = findPrimitive("begin");
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("begin"));
 
-  doBeginEndSubstitutions(t);
+  doBeginEndSubstitutions(*t);
 
-  output.push_back(t.getText());
+  render(*t);
 };
 
 void TemplateRenderer::end()
 {
-  if (!assertPrimitiveExists("end"))
-    return;
-  TemplatePrimitive t(workingTemplate.get("end"));
-
-  doBeginEndSubstitutions(t);
+  if (const TemplatePrimitive* t = findPrimitive("end"))
+  {
+    doBeginEndSubstitutions(*t);
 
-  output.push_back(t.getText());
+    render(*t);
+  }
+  if (sink)
+    flush();
 };
 
 void TemplateRenderer::callGeneric(PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("template" + alternateID))
+  const TemplatePrimitive* t = findPrimitive("template" + getAlternateId(classID));
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("template" + alternateID));
-  output.push_back(t.getText());
+  output += t->getText();
+  flushIfFull();
 }
 
 void TemplateRenderer::setBackgroundColor(Math::Vector3f rgb)
@@ -561,17 +687,21 @@ void TemplateRenderer::drawMesh(
     Math::Vector3f endDir2,
     PrimitiveClass* classID)
 {
-  QString alternateID = getAlternateId(classID);
-  if (!assertPrimitiveExists("mesh" + alternateID))
+  using P = TemplatePlaceholder;
+  if (!findPrimitive("mesh" + getAlternateId(classID)))
+    return;
+  const TemplatePrimitive* t = workingTemplate.find("mesh");
+  if (!t)
     return;
-  TemplatePrimitive t(workingTemplate.get("mesh"));
-  if (t.contains("{uid}"))
+
+  values.clear();
+  if (t->uses(P::uid))
   {
-    t.substitute("{uid}", QString("Box%1").arg(counter++));
+    values.set(P::uid, QString("Box%1").arg(counter++));
   }
 
   // TODO: This really isn't a matrix, we need to find a better way to export the mesh.
-  if (t.contains("{matrix}"))
+  if (t->uses(P::matrix))
   {
     QString mat = QString(
                       "%1 %2 %3 0 %4 %5 %6 0 %7 %8 %9 0 %10 %11 %12 0 %13 %14 %15 0 %16 "
@@ -595,16 +725,21 @@ void TemplateRenderer::drawMesh(
                       .arg(endDir2.y())
                       .arg(endDir2.z());
 
-    t.substitute("{matrix}", mat);
+    values.set(P::matrix, mat);
   }
 
-  t.substitute("{r}", QString::number(rgb.x()));
-  t.substitute("{g}", QString::number(rgb.y()));
-  t.substitute("{b}", QString::number(rgb.z()));
-  t.substitute("{alpha}", QString::number(alpha));
-  t.substitute("{oneminusalpha}", QString::number(1 - alpha));
-
-  output.push_back(t.getText());
+  auto set = [&](P p, double value)
+  {
+    if (t->uses(p))
+      values.set(p, QString::number(value));
+  };
+  set(P::r, rgb.x());
+  set(P::g, rgb.y());
+  set(P::b, rgb.z());
+  set(P::alpha, alpha);
+  set(P::oneminusalpha, 1 - alpha);
+
+  render(*t);
 };
 
 void TemplateRenderer::callCommand(
@@ -615,9 +750,36 @@ void TemplateRenderer::callCommand(
     return;
 }
 
+void TemplateRenderer::setOutput(QIODevice* device, int bufferSize)
+{
+  this->bufferSize = bufferSize;
+  sink = [device](const QByteArray& data)
+  {
+    if (device->write(data) != data.size())
+      throw Exception("Unable to write output: " + device->errorString());
+  };
+}
+
+void TemplateRenderer::setOutput(int fd, int bufferSize)
+{
+  this->bufferSize = bufferSize;
+  sink = [fd](const QByteArray& data)
+  { Misc::FileUtils::writeAll(fd, data.constData(), data.size()); };
+}
+
+void TemplateRenderer::flush()
+{
+  if (!sink || output.isEmpty())
+    return;
+  // See 'getOutput'.
+  output.remove('\r');
+  sink(output.toUtf8());
+  output.clear();
+}
+
 auto TemplateRenderer::getOutput() -> QString
 {
-  QString out = output.join("");
+  QString out = output;
 
   // Normalize output (seems the '\n' converts to CR+LF on windows while saving
   // whereas '\r\n' converts to CR+CR+LF? so we remove the \r's).
@@ -8,8 +8,13 @@
 #include <QString>
 #include <QStringList>
 
+#include <array>
+#include <bitset>
+#include <functional>
 #include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 namespace ssynth
 {
@@ -21,31 +26,144 @@ namespace Rendering
 using namespace Math;
 // using namespace GLEngine;
 
+/// The placeholders which are substituted in the TemplatePrimitive's.
+enum class TemplatePlaceholder
+{
+  // Primitives
+  matrix,
+  columnmatrix,
+  povmatrix,
+  r,
+  g,
+  b,
+  alpha,
+  oneminusalpha,
+  uid,
+  p1x,
+  p1y,
+  p1z,
+  p2x,
+  p2y,
+  p2z,
+  p3x,
+  p3y,
+  p3z,
+  x1,
+  y1,
+  z1,
+  x2,
+  y2,
+  z2,
+  x,
+  y,
+  z,
+  cx,
+  cy,
+  cz,
+  rad,
+  // Begin and end
+  CamPosX,
+  CamPosY,
+  CamPosZ,
+  CamUpX,
+  CamUpY,
+  CamUpZ,
+  CamDirX,
+  CamDirY,
+  CamDirZ,
+  CamRightX,
+  CamRightY,
+  CamRightZ,
+  CamTargetX,
+  CamTargetY,
+  CamTargetZ,
+  CamColumnMatrix,
+  aspect,
+  width,
+  height,
+  fov,
+  BR,
+  BG,
+  BB,
+  BR256,
+  BG256,
+  BB256,
+  Count
+};
+
+/// The values substituted for the placeholders when a TemplatePrimitive is rendered.
+/// Placeholders without a value are left as they are.
+class TemplateValues
+{
+public:
+  void clear() { isSet.reset(); }
+  void set(TemplatePlaceholder p, QString value)
+  {
+    values[int(p)] = std::move(value);
+    isSet.set(int(p));
+  }
+  void set(TemplatePlaceholder p, const std::string& value)
+  {
+    set(p, QString::fromUtf8(value.data(), value.size()));
+  }
+  const QString* get(TemplatePlaceholder p) const
+  {
+    return isSet.test(int(p)) ? &values[int(p)] : nullptr;
+  }
+
+private:
+  std::array<QString, int(TemplatePlaceholder::Count)> values;
+  std::bitset<int(TemplatePlaceholder::Count)> isSet;
+};
+
 /// A TemplatePrimitive is the definition for a single primitive (like Box or Sphere).
 /// It is a simple text string with placeholders for stuff like coordinates and color.
+///
+/// The text is compiled into a sequence of literal texts and placeholders when it is
+/// set, so rendering is a single pass over the segments.
 class TemplatePrimitive
 {
 public:
   TemplatePrimitive() = default;
   TemplatePrimitive(QString def)
-      : def(std::move(def)){};
-  TemplatePrimitive(const TemplatePrimitive& t) { this->def = t.def; };
+      : def(std::move(def))
+  {
+    compile();
+  };
 
-  const QString& getText() { return def; }
+  const QString& getText() const { return def; }
 
   void substitute(const QString& before, const QString& after)
   {
     def.replace(before, after);
+    compile();
   };
   void substitute(const QString& before, const std::string& after)
   {
     def.replace(before, QLatin1String(after.data(), after.size()));
+    compile();
   };
 
   bool contains(const QString& input) { return def.contains(input); };
 
+  /// Returns true if the text contains the placeholder 'p'.
+  bool uses(TemplatePlaceholder p) const { return placeholders.test(int(p)); }
+
+  /// Appends the text to 'out', with the placeholders replaced by their 'values'.
+  void render(QString& out, const TemplateValues& values) const;
+
 private:
+  struct Segment
+  {
+    QString text;        // The literal text (or the placeholder, with its braces).
+    int placeholder{-1}; // A TemplatePlaceholder, or -1 for literal text.
+  };
+
+  void compile();
+
   QString def;
+  std::vector<Segment> segments;
+  std::bitset<int(TemplatePlaceholder::Count)> placeholders;
 };
 
 // A Template contains a number of TemplatePrimitives:
@@ -69,6 +187,12 @@ public:
 
   std::map<QString, TemplatePrimitive>& getPrimitives() { return primitives; }
   TemplatePrimitive get(const QString& name) { return primitives[name]; }
+  /// Returns the primitive 'name', or nullptr if it is not defined.
+  const TemplatePrimitive* find(const QString& name) const
+  {
+    auto it = primitives.find(name);
+    return it != primitives.end() ? &it->second : nullptr;
+  }
   QString getDescription() { return description; }
   QString getFullText() { return fullText; }
   QString getName() { return name; }
@@ -144,12 +268,24 @@ public:
   virtual void setPreviousColor(Math::Vector3f rgb) { this->oldRgb = rgb; }
   virtual void setPreviousAlpha(double alpha) { this->oldAlpha = alpha; }
 
+  /// Returns the output (which is empty if it is streamed, see 'setOutput').
   QString getOutput();
 
+  /// Streams the output to 'device' (or to the file descriptor 'fd') instead of keeping
+  /// it in memory. The text is written whenever 'bufferSize' characters are buffered,
+  /// and by 'end'.
+  void setOutput(QIODevice* device, int bufferSize = 1 << 20);
+  void setOutput(int fd, int bufferSize = 1 << 20);
+
+  /// Writes the buffered text to the output set by 'setOutput'.
+  void flush();
+
   // Issues a command for a specific renderclass such as 'template' or 'opengl'
   virtual void callCommand(const QString& renderClass, const QString& command);
 
   bool assertPrimitiveExists(const QString& templateName);
+  /// Returns the primitive 'templateName', or nullptr (with a warning) if it is missing.
+  const TemplatePrimitive* findPrimitive(const QString& templateName);
 
   void setCamera(
       Vector3f cameraPosition,
@@ -171,16 +307,25 @@ public:
     this->fov = fov;
   }
 
-  void doBeginEndSubstitutions(TemplatePrimitive& t);
+  /// These set the values of the placeholders used by 't'.
+  void doBeginEndSubstitutions(const TemplatePrimitive& t);
 
   void doStandardSubstitutions(
       Math::Vector3f base,
       Math::Vector3f dir1,
       Math::Vector3f dir2,
       Math::Vector3f dir3,
-      TemplatePrimitive& t);
+      const TemplatePrimitive& t);
 
 private:
+  /// Appends 't' rendered with the current values to the output.
+  void render(const TemplatePrimitive& t);
+  void flushIfFull()
+  {
+    if (sink && output.size() >= bufferSize)
+      flush();
+  }
+
   Math::Vector3f cameraPosition;
   Math::Vector3f cameraUp;
   Math::Vector3f cameraRight;
@@ -190,7 +335,10 @@ private:
   Math::Vector3f backRgb;
   double alpha{};
   Template workingTemplate;
-  QStringList output;
+  TemplateValues values;
+  QString output;
+  std::function<void(const QByteArray&)> sink;
+  int bufferSize{};
   int counter;
   int width{};
   int height{};
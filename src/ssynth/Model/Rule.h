@@ -9,9 +9,11 @@ namespace Model
 {
 
 class RuleRef; // forward decl.
-class Builder; // forward decl.
 
 /// (Abstract) Base class for rules.
+///
+/// Rules are not executed directly: the Builder executes the RuleProgram compiled from
+/// the RuleSet, which only calls back into the PrimitiveRules for drawing.
 class Rule
 {
 public:
@@ -27,19 +29,21 @@ public:
 
   QString getName() const { return name; }
 
-  /// When applied the rule will add new pending rules to the ExecutionStack for execution.
-  /// Only PrimitiveRules will make use of the renderer.
-  virtual void apply(Builder* builder) const = 0;
-
   /// Returns a list over rules that this rule references.
   virtual std::vector<RuleRef*> getRuleRefs() const = 0;
 
   virtual void setMaxDepth(int maxDepth) { this->maxDepth = maxDepth; }
   virtual int getMaxDepth() const { return maxDepth; }
 
+  /// The index of the depth of this rule in 'State::maxDepths'.
+  /// Assigned to custom rules by RuleSet::resolveNames, -1 for other rules.
+  int getDepthId() const { return depthId; }
+  void setDepthId(int id) { depthId = id; }
+
 protected:
   QString name;
   int maxDepth;
+  int depthId{-1};
 };
 }
 }
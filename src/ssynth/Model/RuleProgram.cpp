@@ -0,0 +1,419 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Model/AmbiguousRule.h>
+#include <ssynth/Model/Builder.h>
+#include <ssynth/Model/CustomRule.h>
+#include <ssynth/Model/PrimitiveRule.h>
+#include <ssynth/Model/RuleProgram.h>
+#include <ssynth/Model/RuleSet.h>
+
+#include <algorithm>
+#include <map>
+
+namespace ssynth
+{
+using namespace Exceptions;
+
+namespace Model
+{
+
+RuleProgram::RuleProgram(const RuleSet& ruleSet)
+{
+  // Rules are numbered in the order they are found, starting with the start rule.
+  std::map<const Rule*, int> indices;
+  std::vector<const Rule*> pending;
+  auto indexOf = [&](const Rule* rule)
+  {
+    Q_ASSERT(rule);
+    auto [it, inserted] = indices.try_emplace(rule, (int)indices.size());
+    if (inserted)
+      pending.push_back(rule);
+    return it->second;
+  };
+
+  indexOf(ruleSet.getStartRule());
+  for (int i = 0; i < pending.size(); i++)
+  {
+    const Rule* rule = pending[i];
+    RuleEntry entry;
+    entry.source = rule;
+
+    if (auto* pr = dynamic_cast<const PrimitiveRule*>(rule))
+    {
+      entry.kind = RuleKind::Primitive;
+      entry.primitive = pr;
+    }
+    else if (auto* ar = dynamic_cast<const AmbiguousRule*>(rule))
+    {
+      entry.kind = RuleKind::Ambiguous;
+      entry.begin = choices.size();
+      const auto& candidates = ar->getCandidates();
+      const auto& weights = ar->getAccumulatedWeights();
+      for (int j = 0; j < candidates.size(); j++)
+      {
+        choices.push_back(Choice{indexOf(candidates[j]), weights[j]});
+      }
+      entry.end = choices.size();
+      if (entry.begin == entry.end)
+        throw Exception(QString("Rule '%1' has no definitions.").arg(rule->getName()));
+    }
+    else if (auto* cr = dynamic_cast<const CustomRule*>(rule))
+    {
+      entry.kind = RuleKind::Custom;
+      entry.maxDepth = cr->getMaxDepth();
+      entry.depthId = cr->getDepthId();
+      if (RuleRef* retirementRule = cr->getRetirementRule())
+        entry.retirementRule = indexOf(retirementRule->rule());
+
+      entry.begin = actions.size();
+      for (const Action& action : cr->getActions())
+      {
+        ActionEntry a;
+        if (const SetAction* set = action.getSetAction())
+        {
+          a.set = setCommands.size();
+          setCommands.push_back(SetCommand{set->key, set->value});
+          entry.hasSetActions = true;
+        }
+        else
+        {
+          a.rule = indexOf(action.getRuleRef()->rule());
+          a.loopsBegin = loops.size();
+          loops.insert(loops.end(), action.getLoops().begin(), action.getLoops().end());
+          a.loopsEnd = loops.size();
+        }
+        actions.push_back(a);
+      }
+      entry.end = actions.size();
+    }
+    else
+    {
+      throw Exception(QString("Unable to compile rule: %1").arg(rule->getName()));
+    }
+
+    rules.push_back(entry);
+  }
+
+  // A rule runs 'set' actions through the definitions of an ambiguous rule, or through
+  // its retirement rule.
+  for (RuleEntry& rule : rules)
+    rule.runsSetActions = rule.hasSetActions;
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (RuleEntry& rule : rules)
+    {
+      bool runs = rule.runsSetActions;
+      if (rule.kind == RuleKind::Ambiguous)
+      {
+        for (int i = rule.begin; i < rule.end; i++)
+          runs |= rules[choices[i].rule].runsSetActions;
+      }
+      else if (rule.kind == RuleKind::Custom && rule.retirementRule != -1)
+      {
+        runs |= rules[rule.retirementRule].runsSetActions;
+      }
+      changed |= runs != rule.runsSetActions;
+      rule.runsSetActions = runs;
+    }
+  }
+
+  // The descendants of a rule are the rules of its actions, and theirs.
+  for (RuleEntry& rule : rules)
+    rule.reachesSetActions = rule.runsSetActions;
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (RuleEntry& rule : rules)
+    {
+      bool reaches = rule.reachesSetActions;
+      if (rule.kind == RuleKind::Ambiguous)
+      {
+        for (int i = rule.begin; i < rule.end; i++)
+          reaches |= rules[choices[i].rule].reachesSetActions;
+      }
+      else if (rule.kind == RuleKind::Custom)
+      {
+        for (int i = rule.begin; i < rule.end; i++)
+        {
+          if (actions[i].rule != -1)
+            reaches |= rules[actions[i].rule].reachesSetActions;
+        }
+        if (rule.retirementRule != -1)
+          reaches |= rules[rule.retirementRule].reachesSetActions;
+      }
+      changed |= reaches != rule.reachesSetActions;
+      rule.reachesSetActions = reaches;
+    }
+  }
+}
+
+void RuleProgram::updateMaxDepths()
+{
+  for (RuleEntry& rule : rules)
+  {
+    if (rule.kind == RuleKind::Custom)
+      rule.maxDepth = rule.source->getMaxDepth();
+  }
+}
+
+void RuleProgram::execute(Builder* b, int rule) const
+{
+  int depth = 0;
+  const int custom = resolve(b, rule, depth);
+  if (custom == -1)
+    return;
+
+  /// Apply all actions.
+  const int depthId = depthTrackingId(custom);
+  Cursor cursor;
+  State child;
+  for (int action = rules[custom].begin; action < rules[custom].end; action++)
+  {
+    begin(b, action, cursor);
+    int r;
+    while ((r = createChild(b, action, cursor, depthId, depth, child)) != -1)
+    {
+      b->getNextStack().emplace_back(r, std::move(child));
+    }
+  }
+}
+
+auto RuleProgram::resolve(Builder* b, int rule, int& depth) const -> int
+{
+  while (true)
+  {
+    const RuleEntry& r = rules[rule];
+    switch (r.kind)
+    {
+      case RuleKind::Primitive:
+        r.primitive->apply(b);
+        return -1;
+
+      case RuleKind::Ambiguous:
+        rule = chooseDefinition(b, r);
+        break;
+
+      case RuleKind::Custom:
+        depth = 0;
+        /// If there is a maxdepth set for this object check it.
+        if (r.maxDepth != -1)
+        {
+          Q_ASSERT(r.depthId >= 0);
+          DepthTable& maxDepths = b->getState().maxDepths;
+          const int current = maxDepths.get(r.depthId);
+          if (current == DepthTable::Unset)
+          {
+            /// We will add a new maxdepth for this rule to the state.
+            depth = r.maxDepth - 1;
+          }
+          else if (current <= 0)
+          {
+            /// This rule is retired.
+            if (r.retirementRule == -1)
+              return -1;
+            maxDepths.set(r.depthId, r.maxDepth);
+            rule = r.retirementRule;
+            break;
+          }
+          else
+          {
+            /// Decrease depth.
+            depth = current - 1;
+          }
+        }
+        return rule;
+    }
+  }
+}
+
+auto RuleProgram::chooseDefinition(Builder* b, const RuleEntry& ambiguous) const -> int
+{
+  // The first definition whose accumulated weight is not below the random value.
+  const auto first = choices.begin() + ambiguous.begin;
+  const auto last = choices.begin() + ambiguous.end;
+  const double random = (last - 1)->accumulatedWeight
+                        * b->getState().random.Geometry().getDouble();
+  auto it = std::lower_bound(
+      first,
+      last,
+      random,
+      [](const Choice& c, double value) { return c.accumulatedWeight < value; });
+  if (it == last)
+    --it;
+  return it->rule;
+}
+
+void RuleProgram::begin(Builder* b, int action, Cursor& cursor) const
+{
+  const ActionEntry& a = actions[action];
+  if (a.set != -1)
+  {
+    b->setCommand(setCommands[a.set].key, setCommands[a.set].value);
+    cursor.done = true;
+    return;
+  }
+
+  const int count = a.loopsEnd - a.loopsBegin;
+  cursor.counters.assign(count, 1);
+  cursor.done = false;
+  if (count == 0)
+    return;
+
+  const TransformationLoop* actionLoops = loops.data() + a.loopsBegin;
+  cursor.prefix = b->getState().matrix * actionLoops[0].transformation.getMatrix();
+  cursor.powers.resize(count);
+  cursor.suffix = Math::AffineMatrix4f::Identity();
+  for (int i = 1; i < count; i++)
+  {
+    cursor.powers[i] = actionLoops[i].transformation.getMatrix();
+    cursor.suffix = cursor.suffix * cursor.powers[i];
+  }
+
+  cursor.replaysColors = false;
+  for (int i = 0; i < count; i++)
+    cursor.replaysColors |= actionLoops[i].transformation.drawsRandomColor();
+  if (!cursor.replaysColors)
+  {
+    cursor.colors.resize(count);
+    int combinations = 1;
+    for (int i = 0; i < count; i++)
+    {
+      if (i > 0)
+        combinations *= actionLoops[i - 1].repetitions;
+      cursor.colors[i].resize(combinations);
+    }
+  }
+}
+
+void RuleProgram::advanceMatrices(
+    const State& s,
+    const TransformationLoop* actionLoops,
+    Cursor& cursor) const
+{
+  // Every counter was either increased by one, reset to one or left unchanged.
+  const std::vector<int>& counters = cursor.counters;
+  const std::vector<int>& last = cursor.lastCounters;
+  if (counters[0] == 1)
+    cursor.prefix = s.matrix * actionLoops[0].transformation.getMatrix();
+  else
+    cursor.prefix = cursor.prefix * actionLoops[0].transformation.getMatrix();
+
+  bool suffixChanged = false;
+  for (int i = 1; i < counters.size(); i++)
+  {
+    if (counters[i] == last[i])
+      continue;
+    suffixChanged = true;
+    if (counters[i] == 1)
+      cursor.powers[i] = actionLoops[i].transformation.getMatrix();
+    else
+      cursor.powers[i] = cursor.powers[i] * actionLoops[i].transformation.getMatrix();
+  }
+
+  if (suffixChanged)
+  {
+    cursor.suffix = cursor.powers[1];
+    for (int i = 2; i < counters.size(); i++)
+      cursor.suffix = cursor.suffix * cursor.powers[i];
+  }
+}
+
+auto RuleProgram::createChild(
+    Builder* b,
+    int action,
+    Cursor& cursor,
+    int depthId,
+    int ruleDepth,
+    State& child) const -> int
+{
+  if (cursor.done)
+  {
+    return -1;
+  }
+
+  const ActionEntry& a = actions[action];
+  const TransformationLoop* actionLoops = loops.data() + a.loopsBegin;
+
+  State& s = b->getState();
+  child = s;
+  child.random = s.random.createChild();
+
+  std::vector<int>& counters = cursor.counters;
+  if (counters.size() == 0)
+  {
+    cursor.done = true;
+  }
+  else
+  {
+    // The previous state is only needed for meshes.
+    if (b->tracksPreviousState())
+    {
+      // Copy the old matrix...
+      child.setPreviousState(s.matrix, s.hsv, s.alpha);
+    }
+    child.matrix = counters.size() == 1 ? cursor.prefix : cursor.prefix * cursor.suffix;
+
+    if (cursor.replaysColors)
+    {
+      // The colors are replayed in sequence, so that random colors are drawn as if
+      // every transformation was applied separately.
+      for (int i = 0; i < counters.size(); i++)
+      {
+        const Transformation& t = actionLoops[i].transformation;
+        const int times = t.changesColor() ? counters[i] : 1;
+        for (int j = 0; j < times; j++)
+        {
+          t.applyColor(child, b->getColorPool());
+        }
+      }
+    }
+    else
+    {
+      int index = 0; // c[0..i-1], as an index in 'colors[i]'
+      int stride = 1;
+      for (int i = 0; i < counters.size(); i++)
+      {
+        Cursor::Color& color = cursor.colors[i][index];
+        if (counters[i] == 1)
+          color = Cursor::Color{child.hsv, child.alpha};
+        actionLoops[i].transformation.applyColor(color.hsv, color.alpha);
+        child.hsv = color.hsv;
+        child.alpha = color.alpha;
+        index += (counters[i] - 1) * stride;
+        stride *= actionLoops[i].repetitions;
+      }
+    }
+
+    // increase lowest counter...
+    cursor.lastCounters = counters;
+    counters[0]++;
+    for (int i = 0; i < counters.size(); i++)
+    {
+      if (counters[i] > actionLoops[i].repetitions)
+      {
+        if (i == counters.size() - 1)
+        {
+          cursor.done = true;
+        }
+        else
+        {
+          counters[i] = 1;
+          counters[i + 1]++;
+        }
+      }
+    }
+    if (!cursor.done)
+    {
+      advanceMatrices(b->getState(), actionLoops, cursor);
+    }
+  }
+
+  if (depthId != -1)
+  {
+    child.maxDepths.set(depthId, ruleDepth);
+  }
+  return a.rule;
+}
+
+}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <ssynth/Model/TransformationLoop.h>
+
+#include <QString>
+
+#include <vector>
+
+namespace ssynth
+{
+namespace Model
+{
+
+class Builder;       // forward decl.
+class PrimitiveRule; // forward decl.
+class Rule;          // forward decl.
+class RuleSet;       // forward decl.
+struct State;        // forward decl.
+
+/// A RuleSet compiled into flat tables, which are interpreted by the Builder.
+///
+/// The RuleSet is the parsed representation of a script: a graph of rules linked by
+/// (resolved) RuleRef's. The program stores the rules reachable from the start rule
+/// in a contiguous rule table, and refers to rules, actions and loops by their index,
+/// so executing a rule neither needs virtual calls nor chases pointers.
+///
+/// Only the primitives are still drawn by their PrimitiveRule.
+class RuleProgram
+{
+public:
+  /// The index of the start rule.
+  static constexpr int StartRule = 0;
+
+  /// The position in the sequence of states created by an action.
+  ///
+  /// The matrices of the loops are evaluated incrementally: with the loop counters c[i]
+  /// (c[0] changes fastest), the matrix of a new state is
+  ///    s * T0^c[0] * (T1^c[1] * ... * Tn^c[n])
+  /// where the first product is updated by one multiplication per state, and the powers
+  /// of the other loops are only updated when their counters change.
+  ///
+  /// The colors are applied in sequence (T0 c[0] times, then T1 c[1] times, ...) and do
+  /// not compose, so the color after loop i is kept for every value of c[0..i-1]: it is
+  /// the color after loop i-1 with Ti applied c[i] times, and costs one color
+  /// application per loop and state. If a loop draws random colors, the colors are
+  /// replayed on every state instead, since the draws depend on the state.
+  struct Cursor
+  {
+    std::vector<int> counters; // Loop counters
+    bool done{true};
+
+    Math::AffineMatrix4f prefix;              // s * T0^c[0]
+    Math::AffineMatrix4f suffix;              // T1^c[1] * ... * Tn^c[n]
+    std::vector<Math::AffineMatrix4f> powers; // Ti^c[i] (for i > 0)
+    std::vector<int> lastCounters;
+
+    struct Color
+    {
+      Math::Vector3f hsv;
+      float alpha;
+    };
+    std::vector<std::vector<Color>> colors; // Color after loop i, by c[0..i-1]
+    bool replaysColors{false};
+  };
+
+  /// Compiles the rules reachable from the start rule
+  /// (the names must have been resolved, see RuleSet::resolveNames).
+  explicit RuleProgram(const RuleSet& ruleSet);
+
+  /// Reloads the max. depths of the rules (see RuleSet::setRulesMaxDepth).
+  void updateMaxDepths();
+
+  /// Executes 'rule' in the state of 'b': the new states are added to b's next stack.
+  void execute(Builder* b, int rule) const;
+
+  /// Applies 'rule' in the state of 'b' as far as possible without creating new states:
+  /// primitives are drawn, ambiguous rules are chosen, and max. depths are checked.
+  /// Returns the custom rule whose actions should be expanded (with 'depth' set to the
+  /// max. depth of the new states), or -1 if nothing is left to expand.
+  int resolve(Builder* b, int rule, int& depth) const;
+
+  /// The actions of custom rule 'rule' are the indices '[actionsBegin;actionsEnd)'.
+  int actionsBegin(int rule) const { return rules[rule].begin; }
+  int actionsEnd(int rule) const { return rules[rule].end; }
+  /// True if executing 'rule' may run 'set' actions (its own, or the ones of the rule
+  /// it resolves to).
+  bool runsSetActions(int rule) const { return rules[rule].runsSetActions; }
+  /// True if 'set' actions may run while 'rule' or its descendants are executed.
+  bool reachesSetActions(int rule) const { return rules[rule].reachesSetActions; }
+
+  /// The depth id stored in the states created by custom rule 'rule' (or -1).
+  int depthTrackingId(int rule) const
+  {
+    return rules[rule].maxDepth != -1 ? rules[rule].depthId : -1;
+  }
+
+  /// Starts iterating over the states created by 'action' (used for creating the
+  /// states one at a time, see 'createChild'). A 'set' action is executed right away.
+  void begin(Builder* b, int action, Cursor& cursor) const;
+
+  /// Creates the next state of 'action' from the state of 'b' and stores it in 'child'.
+  /// If 'depthId' != -1 the new state is set with a depth equal to 'ruleDepth'.
+  /// Returns the rule to apply to the new state, or -1 if the cursor is done.
+  int createChild(
+      Builder* b,
+      int action,
+      Cursor& cursor,
+      int depthId,
+      int ruleDepth,
+      State& child) const;
+
+private:
+  enum class RuleKind
+  {
+    Primitive,
+    Custom,
+    Ambiguous
+  };
+
+  struct RuleEntry
+  {
+    RuleKind kind;
+    int maxDepth{-1};
+    int depthId{-1};
+    int retirementRule{-1};
+    bool hasSetActions{false};
+    bool runsSetActions{false};
+    bool reachesSetActions{false};
+    // Custom rules: actions[begin;end), ambiguous rules: choices[begin;end).
+    int begin{};
+    int end{};
+    const PrimitiveRule* primitive{};
+    const Rule* source{};
+  };
+
+  struct ActionEntry
+  {
+    int rule{-1}; // -1 for 'set' actions.
+    int set{-1};  // Index in 'setCommands'.
+    int loopsBegin{};
+    int loopsEnd{};
+  };
+
+  /// A definition of an ambiguous rule, with the accumulated weights of the definitions
+  /// up to this one (see AmbiguousRule::buildSelectionTable).
+  struct Choice
+  {
+    int rule;
+    double accumulatedWeight;
+  };
+
+  struct SetCommand
+  {
+    QString key;
+    QString value;
+  };
+
+  int chooseDefinition(Builder* b, const RuleEntry& ambiguous) const;
+
+  /// Updates the matrices of 'cursor' after its counters were advanced.
+  void advanceMatrices(
+      const State& s,
+      const TransformationLoop* actionLoops,
+      Cursor& cursor) const;
+
+  std::vector<RuleEntry> rules;
+  std::vector<ActionEntry> actions;
+  std::vector<Choice> choices;
+  std::vector<TransformationLoop> loops;
+  std::vector<SetCommand> setCommands;
+};
+
+}
+}
@@ -1,4 +1,3 @@
-#include <boost/range/algorithm_ext.hpp>
 #include <ssynth/Exception.h>
 #include <ssynth/Logging.h>
 #include <ssynth/Model/AmbiguousRule.h>
@@ -11,8 +10,10 @@
 #include <QRegularExpression>
 #include <QStringList>
 
-#include <map>
+#include <algorithm>
+#include <set>
 #include <typeinfo>
+#include <unordered_set>
 
 namespace ssynth
 {
@@ -40,6 +41,7 @@ RuleSet::RuleSet()
   rules.push_back(new PrimitiveRule(PrimitiveRule::Grid, defaultClass));
   rules.push_back(new PrimitiveRule(PrimitiveRule::Template, defaultClass));
   rules.push_back(topLevelRule);
+  indexRules();
 };
 
 void RuleSet::setRulesMaxDepth(int maxDepth)
@@ -59,6 +61,8 @@ RuleSet::~RuleSet()
   delete defaultClass;
   for (auto& rule : rules)
     delete rule;
+  for (auto& rule : resolvedRules)
+    delete rule;
   //for (int i = 0; i < primitiveClasses.size(); i++) delete(primitiveClasses[i]);
 }
 
@@ -66,72 +70,79 @@ void RuleSet::addRule(Rule* rule)
 {
   // Check if the rule name is already used...
   QString name = rule->getName();
-
-  for (int i = 0; i < rules.size(); i++)
+  auto [it, inserted] = ruleIndices.try_emplace(name, int(rules.size()));
+  if (inserted)
   {
+    rules.push_back(rule);
+    return;
+  }
 
-    if (rules[i]->getName() == name)
-    {
-      if (typeid(*rules[i]) == typeid(CustomRule))
-      {
-        // A Custom rule already exists with the same name.
-        // Now we must remove the existing rule, and create a new ambiguous rule hosting them both.
-
-        Rule* r = rules[i];
-        boost::range::remove_erase(rules, r);
-        auto* cr1 = dynamic_cast<CustomRule*>(r);
-
-        auto* ar = new AmbiguousRule(name);
-        ar->appendRule(cr1);
-
-        auto* cr2 = dynamic_cast<CustomRule*>(rule);
-        if (!cr2)
-          throw Exception(
-              "Trying to add non-custom rule to ambiguous rule: '%1'. " + name);
-        ar->appendRule(cr2);
-
-        rules.push_back(ar);
-
-        return;
-      }
-      else if (typeid(*rules[i]) == typeid(PrimitiveRule))
-      {
-        // A primitive rule already exists with the same name. This is not acceptable.
-        throw Exception(QString("A primitive rule already exists with the name: '%1'. "
-                                "New definitions can not merged.")
-                            .arg(name));
-      }
-      else if (typeid(*rules[i]) == typeid(AmbiguousRule))
-      {
-        // A ambiguous rule already exists with the same name. We will add to it.
-        auto* ar = dynamic_cast<AmbiguousRule*>(rules[i]);
-        auto* cr = dynamic_cast<CustomRule*>(rule);
-        if (!cr)
-          throw Exception(
-              "Trying to add non-custom rule to ambiguous rule: '%1'. " + name);
-        ar->appendRule(cr);
-        return;
-      }
-      else
-      {
-        WARNING("Unknown typeid");
-      }
-    }
+  Rule*& existing = rules[it->second];
+  if (typeid(*existing) == typeid(CustomRule))
+  {
+    // A Custom rule already exists with the same name.
+    // Now we must replace the existing rule by a new ambiguous rule hosting them both.
+    auto* cr2 = dynamic_cast<CustomRule*>(rule);
+    if (!cr2)
+      throw Exception("Trying to add non-custom rule to ambiguous rule: '%1'. " + name);
+
+    auto* ar = new AmbiguousRule(name);
+    ar->appendRule(static_cast<CustomRule*>(existing));
+    ar->appendRule(cr2);
+    existing = ar;
+  }
+  else if (typeid(*existing) == typeid(PrimitiveRule))
+  {
+    // A primitive rule already exists with the same name. This is not acceptable.
+    throw Exception(QString("A primitive rule already exists with the name: '%1'. "
+                            "New definitions can not merged.")
+                        .arg(name));
+  }
+  else if (typeid(*existing) == typeid(AmbiguousRule))
+  {
+    // A ambiguous rule already exists with the same name. We will add to it.
+    auto* ar = static_cast<AmbiguousRule*>(existing);
+    auto* cr = dynamic_cast<CustomRule*>(rule);
+    if (!cr)
+      throw Exception("Trying to add non-custom rule to ambiguous rule: '%1'. " + name);
+    ar->appendRule(cr);
   }
+  else
+  {
+    WARNING("Unknown typeid");
+    rules.push_back(rule);
+  }
+}
 
-  rules.push_back(rule);
+void RuleSet::indexRules()
+{
+  ruleIndices.clear();
+  for (int i = 0; i < rules.size(); i++)
+    ruleIndices.try_emplace(rules[i]->getName(), i);
 }
 
 /// Resolve symbolic names into pointers
 auto RuleSet::resolveNames() -> QStringList
 {
+  assignDepthIds();
 
-  // build map
-  std::map<QString, Rule*> map;
-  for (auto& rule : rules)
-    map[rule->getName()] = rule;
+  // The rules created for the class specifiers and the triangles, by name.
+  std::unordered_map<QString, Rule*> created;
+  auto find = [&](const QString& name) -> Rule*
+  {
+    if (auto it = ruleIndices.find(name); it != ruleIndices.end())
+      return rules[it->second];
+    if (auto it = created.find(name); it != created.end())
+      return it->second;
+    return nullptr;
+  };
 
   QStringList usedPrimitives;
+  std::unordered_set<QString> usedPrimitiveNames;
+
+  // The Polygons rules (i.e. Triangle[x,y,z]) are special rules, each created on the fly.
+  QRegularExpression triangle(
+      QRegularExpression::anchoredPattern("triangle\\[(.*)\\]"));
 
   // resolve rules.
   for (auto& rule : rules)
@@ -142,7 +153,8 @@ auto RuleSet::resolveNames() -> QStringList
     for (auto& ref : refs)
     {
       QString name = ref->getReference();
-      if (!map.contains(name))
+      Rule* target = find(name);
+      if (!target)
       {
         // We could not resolve the name.
         // Check if it has a class specifier.
@@ -152,7 +164,8 @@ auto RuleSet::resolveNames() -> QStringList
           QString baseName = sl[0];
           QString classID = sl[1];
 
-          if (!map.contains(baseName))
+          Rule* r = find(baseName);
+          if (!r)
           {
             throw Exception(QString("Unable to resolve base rule name: %1 for rule %2")
                                 .arg(baseName)
@@ -160,8 +173,6 @@ auto RuleSet::resolveNames() -> QStringList
           }
 
           // Now we have to create a new instance of this rule.
-          Rule* r = map[baseName];
-
           if (typeid(*r) != typeid(PrimitiveRule))
           {
             throw Exception(QString("Only primitive rules (box, sphere, ...) may have a "
@@ -173,16 +184,13 @@ auto RuleSet::resolveNames() -> QStringList
           auto* newRule = new PrimitiveRule(*pr);
           newRule->setClass(getPrimitiveClass(classID));
 
-          map[name] = newRule;
+          target = newRule;
 
           //INFO("Created new class for rule: " + name);
         }
         else
         {
-          // The Polygons rules (i.e. Triangle[x,y,z]) are special rules, each created on the fly.
-          QRegularExpression r(
-              QRegularExpression::anchoredPattern("triangle\\[(.*)\\]"));
-          if (auto rmatch = r.match(name); rmatch.hasMatch())
+          if (auto rmatch = triangle.match(name); rmatch.hasMatch())
           {
             // Check the arguments.
             INFO("Found:" + rmatch.captured(1));
@@ -224,26 +232,83 @@ auto RuleSet::resolveNames() -> QStringList
               v.emplace_back(f1, f2, f3);
             }
 
-            map[name] = new TriangleRule(v[0], v[1], v[2], defaultClass);
+            target = new TriangleRule(v[0], v[1], v[2], defaultClass);
           }
           else
           {
             throw Exception(QString("Unable to resolve rule: %1").arg(name));
           }
         }
+        created[name] = target;
+        resolvedRules.push_back(target);
       }
-      if (dynamic_cast<PrimitiveRule*>(map[name]))
+      if (dynamic_cast<PrimitiveRule*>(target))
       {
-        if (!usedPrimitives.contains(name))
+        if (usedPrimitiveNames.insert(name).second)
           usedPrimitives.push_back(name);
       }
-      ref->setRef(map[name]);
+      ref->setRef(target);
     }
   }
 
+  for (auto rule : rules)
+  {
+    if (auto* ar = dynamic_cast<AmbiguousRule*>(rule))
+      ar->buildSelectionTable();
+  }
+
+  meshReachable = findReachableMesh();
   return usedPrimitives;
 }
 
+auto RuleSet::findReachableMesh() const -> bool
+{
+  std::set<const Rule*> visited;
+  std::vector<const Rule*> pending{getStartRule()};
+  while (!pending.empty())
+  {
+    const Rule* rule = pending.back();
+    pending.pop_back();
+    if (!visited.insert(rule).second)
+      continue;
+
+    auto* pr = dynamic_cast<const PrimitiveRule*>(rule);
+    if (pr && pr->getType() == PrimitiveRule::Mesh)
+      return true;
+
+    for (auto ref : rule->getRuleRefs())
+      pending.push_back(ref->rule());
+  }
+  return false;
+}
+
+auto RuleSet::getCustomRules() const -> std::vector<CustomRule*>
+{
+  std::vector<CustomRule*> customRules;
+  for (auto rule : rules)
+  {
+    if (auto* cr = dynamic_cast<CustomRule*>(rule))
+      customRules.push_back(cr);
+    else if (auto* ar = dynamic_cast<AmbiguousRule*>(rule))
+      for (auto cr : ar->getRules())
+        customRules.push_back(cr);
+  }
+  return customRules;
+}
+
+void RuleSet::assignDepthIds()
+{
+  std::vector<CustomRule*> customRules = getCustomRules();
+
+  // Rules with a max. depth are numbered first, so their depths are stored inline.
+  std::stable_partition(
+      customRules.begin(),
+      customRules.end(),
+      [](const CustomRule* r) { return r->getMaxDepth() != -1; });
+  for (int i = 0; i < customRules.size(); i++)
+    customRules[i]->setDepthId(i);
+}
+
 ///
 auto RuleSet::getUnreferencedNames() -> QStringList
 {
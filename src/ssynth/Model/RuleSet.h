@@ -4,6 +4,10 @@
 #include <ssynth/Model/PrimitiveClass.h>
 #include <ssynth/Model/Rule.h>
 
+#include <QHash> // std::hash<QString>
+
+#include <unordered_map>
+
 namespace ssynth
 {
 namespace Model
@@ -33,8 +37,16 @@ public:
 
   Rule* getStartRule() const;
 
+  /// True if a 'mesh' primitive can be reached from the start rule
+  /// (only valid after 'resolveNames').
+  bool isMeshReachable() const { return meshReachable; }
+
   CustomRule* getTopLevelRule() const { return topLevelRule; }
 
+  /// The custom rules, with the definitions of the ambiguous rules.
+  /// The order only depends on the script (it is kept by 'RuleSetCache').
+  std::vector<CustomRule*> getCustomRules() const;
+
   /// For debug
   void dumpInfo() const;
 
@@ -48,11 +60,26 @@ public:
   PrimitiveClass* getDefaultClass() { return defaultClass; }
 
 private:
+  friend class RuleSetCache;
+
+  /// Rebuilds 'ruleIndices' from 'rules'.
+  void indexRules();
+  /// Assigns the dense ids used for storing the depths of the custom rules in a State.
+  void assignDepthIds();
+  bool findReachableMesh() const;
+
   std::vector<Rule*> rules;
+  // The position of the rules in 'rules', by name (when a custom rule gets a second
+  // definition, it is replaced by an ambiguous rule at the same position).
+  std::unordered_map<QString, int> ruleIndices;
+  // The rules created by 'resolveNames' for the references like 'box::metal' or
+  // 'triangle[...]' (not in 'rules', as they can not be referenced by name otherwise).
+  std::vector<Rule*> resolvedRules;
   std::vector<PrimitiveClass*> primitiveClasses;
   PrimitiveClass* defaultClass;
   CustomRule* topLevelRule;
   bool recurseDepth;
+  bool meshReachable{true};
 };
 
 }
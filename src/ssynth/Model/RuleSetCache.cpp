@@ -0,0 +1,603 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Logging.h>
+#include <ssynth/Model/AmbiguousRule.h>
+#include <ssynth/Model/CustomRule.h>
+#include <ssynth/Model/PrimitiveRule.h>
+#include <ssynth/Model/RuleRef.h>
+#include <ssynth/Model/RuleSet.h>
+#include <ssynth/Model/RuleSetCache.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Logging;
+using namespace Math;
+
+namespace Model
+{
+
+namespace
+{
+// The file is a Header, followed by the classes, rules, actions and loops records, and
+// the strings. All records have sizes multiple of 8, so they are aligned when the file
+// is mapped.
+constexpr char Magic[8] = {'S', 'S', 'Y', 'N', 'R', 'U', 'L', 'E'};
+// Must be increased when the format, or the RuleSets built from scripts, change.
+constexpr uint32_t FormatVersion = 2;
+constexpr int MaxKeySize = 32;
+
+// UTF-8 bytes in the strings.
+struct StringRecord
+{
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t keySize;
+  char key[MaxKeySize];
+  uint32_t classCount;
+  uint32_t ruleCount;
+  uint32_t actionCount;
+  uint32_t loopCount;
+  uint32_t stringsSize;
+  int32_t startRule;
+  uint8_t recurseDepthFirst;
+  uint8_t meshReachable;
+  uint8_t padding[6];
+};
+
+// The first class is the default class.
+struct ClassRecord
+{
+  StringRecord name;
+  double reflection;
+  double ambient;
+  double specular;
+  double diffuse;
+  uint8_t hasShadows;
+  uint8_t castShadows;
+  uint8_t padding[6];
+};
+
+enum RuleKind : uint8_t
+{
+  PrimitiveKind,
+  TriangleKind,
+  CustomKind,
+  AmbiguousKind
+};
+
+// Where the rule is stored.
+enum RuleOwner : uint8_t
+{
+  RuleSetOwner,       // RuleSet::rules
+  AmbiguousRuleOwner, // The definitions of an ambiguous rule
+  ResolvedOwner       // RuleSet::resolvedRules
+};
+
+struct RuleRecord
+{
+  uint8_t kind;
+  uint8_t owner;
+  uint8_t primitiveType;
+  uint8_t padding;
+  int32_t maxDepth;
+  int32_t depthId;
+  int32_t primitiveClass;
+  StringRecord name;
+  double weight;
+  // The actions of a custom rule, or the definitions (rules) of an ambiguous rule.
+  uint32_t first;
+  uint32_t count;
+  StringRecord retirementName;
+  int32_t retirementRule; // -1 if none
+  float points[9];        // Triangles
+};
+
+struct ActionRecord
+{
+  uint32_t firstLoop;
+  uint32_t loopCount;
+  StringRecord ruleName;
+  int32_t rule; // -1 if none
+  uint32_t isSet;
+  StringRecord setKey;
+  StringRecord setValue;
+};
+
+struct LoopRecord
+{
+  int32_t repetitions;
+  float matrix[12];
+  float deltaH;
+  float scaleS;
+  float scaleV;
+  float scaleAlpha;
+  uint32_t blendColor; // QRgb
+  uint8_t blendColorValid;
+  uint8_t absoluteColor;
+  uint8_t padding[6];
+  double strength;
+};
+
+template <typename T>
+constexpr bool isRecord = std::is_trivially_copyable_v<T> && sizeof(T) % 8 == 0;
+static_assert(isRecord<Header> && isRecord<ClassRecord> && isRecord<RuleRecord>);
+static_assert(isRecord<ActionRecord> && isRecord<LoopRecord>);
+
+template <typename T>
+void append(QByteArray& out, const std::vector<T>& records)
+{
+  out.append(
+      reinterpret_cast<const char*>(records.data()), int(records.size() * sizeof(T)));
+}
+
+bool isValidRange(uint64_t first, uint64_t count, uint64_t size)
+{
+  return first <= size && count <= size - first;
+}
+}
+
+RuleSetCache::RuleSetCache(const QString& directory)
+    : directory(directory)
+{
+}
+
+auto RuleSetCache::keyOf(const QString& script) -> QByteArray
+{
+  return QCryptographicHash::hash(script.toUtf8(), QCryptographicHash::Sha256);
+}
+
+auto RuleSetCache::fileOf(const QByteArray& key) const -> QString
+{
+  return directory + "/" + QString(key.toHex()) + ".ruleset";
+}
+
+auto RuleSetCache::load(const QString& script) const -> RuleSet*
+{
+  const QByteArray key = keyOf(script);
+  QFile file(fileOf(key));
+  if (!file.open(QIODevice::ReadOnly))
+    return nullptr;
+
+  const qint64 size = file.size();
+  uchar* data = file.map(0, size);
+  if (!data)
+    return nullptr;
+  RuleSet* ruleSet = deserialize(reinterpret_cast<const char*>(data), size, key);
+  file.unmap(data);
+  return ruleSet;
+}
+
+void RuleSetCache::store(const QString& script, const RuleSet& ruleSet) const
+{
+  const QByteArray key = keyOf(script);
+  const QByteArray data = serialize(ruleSet, key);
+  const QString fileName = fileOf(key);
+
+  // The file is replaced atomically, so concurrent jobs never read a partial entry.
+  QSaveFile file(fileName);
+  if (!QDir().mkpath(directory) || !file.open(QIODevice::WriteOnly)
+      || file.write(data) != data.size() || !file.commit())
+  {
+    WARNING(QString("Unable to write the RuleSet cache file: %1").arg(fileName));
+  }
+}
+
+auto RuleSetCache::serialize(const RuleSet& ruleSet, const QByteArray& key) -> QByteArray
+{
+  if (key.size() > MaxKeySize)
+    throw Exception("RuleSet cache keys are limited to 32 bytes.");
+
+  std::vector<ClassRecord> classes;
+  std::vector<RuleRecord> rules;
+  std::vector<ActionRecord> actions;
+  std::vector<LoopRecord> loops;
+  QByteArray strings;
+
+  auto string = [&](const QString& s) -> StringRecord
+  {
+    const QByteArray utf8 = s.toUtf8();
+    const StringRecord record{uint32_t(strings.size()), uint32_t(utf8.size())};
+    strings.append(utf8);
+    return record;
+  };
+
+  std::unordered_map<const PrimitiveClass*, int32_t> classIndices;
+  auto addClass = [&](const PrimitiveClass* c)
+  {
+    classIndices[c] = classes.size();
+    ClassRecord& record = classes.emplace_back();
+    record.name = string(c->name);
+    record.reflection = c->reflection;
+    record.ambient = c->ambient;
+    record.specular = c->specular;
+    record.diffuse = c->diffuse;
+    record.hasShadows = c->hasShadows;
+    record.castShadows = c->castShadows;
+  };
+  addClass(ruleSet.defaultClass);
+  for (const PrimitiveClass* c : ruleSet.primitiveClasses)
+    addClass(c);
+
+  // Numbers all the rules first, so the references can be stored as indices.
+  std::vector<std::pair<Rule*, RuleOwner>> allRules;
+  for (Rule* rule : ruleSet.rules)
+    allRules.emplace_back(rule, RuleSetOwner);
+  for (Rule* rule : ruleSet.rules)
+  {
+    if (auto* ar = dynamic_cast<AmbiguousRule*>(rule))
+      for (CustomRule* cr : ar->getRules())
+        allRules.emplace_back(cr, AmbiguousRuleOwner);
+  }
+  for (Rule* rule : ruleSet.resolvedRules)
+    allRules.emplace_back(rule, ResolvedOwner);
+
+  std::unordered_map<const Rule*, int32_t> ruleIndices;
+  for (int32_t i = 0; i < allRules.size(); i++)
+    ruleIndices[allRules[i].first] = i;
+
+  auto indexOf = [&](RuleRef* ref) -> int32_t
+  {
+    auto it = ruleIndices.find(ref->rule());
+    if (it == ruleIndices.end())
+      throw Exception(
+          QString("Only resolved RuleSets can be cached (unresolved rule: %1).")
+              .arg(ref->getReference()));
+    return it->second;
+  };
+
+  auto addLoop = [&](const TransformationLoop& loop)
+  {
+    const Transformation& t = loop.transformation;
+    LoopRecord& record = loops.emplace_back();
+    record.repetitions = loop.repetitions;
+    for (int row = 0; row < 3; row++)
+      for (int col = 0; col < 4; col++)
+        record.matrix[row * 4 + col] = t.matrix(row, col);
+    record.deltaH = t.deltaH;
+    record.scaleS = t.scaleS;
+    record.scaleV = t.scaleV;
+    record.scaleAlpha = t.scaleAlpha;
+    record.blendColor = t.blendColor.rgba();
+    record.blendColorValid = t.blendColor.isValid();
+    record.absoluteColor = t.absoluteColor;
+    record.strength = t.strength;
+  };
+
+  auto addAction = [&](const Action& action)
+  {
+    ActionRecord record{};
+    record.firstLoop = loops.size();
+    record.loopCount = action.getLoops().size();
+    for (const TransformationLoop& loop : action.getLoops())
+      addLoop(loop);
+    record.rule = -1;
+    if (RuleRef* ref = action.getRuleRef())
+    {
+      record.ruleName = string(ref->getReference());
+      record.rule = indexOf(ref);
+    }
+    if (const SetAction* set = action.getSetAction())
+    {
+      record.isSet = 1;
+      record.setKey = string(set->key);
+      record.setValue = string(set->value);
+    }
+    actions.push_back(record);
+  };
+
+  for (const auto& [rule, owner] : allRules)
+  {
+    RuleRecord record{};
+    record.owner = owner;
+    record.maxDepth = rule->getMaxDepth();
+    record.depthId = rule->getDepthId();
+    record.name = string(rule->getName());
+    record.retirementRule = -1;
+
+    if (auto* pr = dynamic_cast<PrimitiveRule*>(rule))
+    {
+      record.primitiveType = pr->getType();
+      auto it = classIndices.find(pr->getClass());
+      if (it == classIndices.end())
+        throw Exception("Unknown primitive class for rule: " + pr->getName());
+      record.primitiveClass = it->second;
+      record.kind = PrimitiveKind;
+      if (auto* tr = dynamic_cast<TriangleRule*>(rule))
+      {
+        record.kind = TriangleKind;
+        const Vector3f* points[3] = {&tr->p1, &tr->p2, &tr->p3};
+        for (int i = 0; i < 3; i++)
+          for (int j = 0; j < 3; j++)
+            record.points[i * 3 + j] = (*points[i])[j];
+      }
+    }
+    else if (auto* cr = dynamic_cast<CustomRule*>(rule))
+    {
+      record.kind = CustomKind;
+      record.weight = cr->getWeight();
+      record.first = actions.size();
+      record.count = cr->getActions().size();
+      for (const Action& action : cr->getActions())
+        addAction(action);
+      if (RuleRef* ref = cr->getRetirementRule())
+      {
+        record.retirementName = string(ref->getReference());
+        record.retirementRule = indexOf(ref);
+      }
+    }
+    else if (auto* ar = dynamic_cast<AmbiguousRule*>(rule))
+    {
+      record.kind = AmbiguousKind;
+      const std::vector<CustomRule*> definitions = ar->getRules();
+      record.first = definitions.empty() ? 0 : ruleIndices[definitions.front()];
+      record.count = definitions.size();
+    }
+    else
+    {
+      throw Exception("Unknown rule type for rule: " + rule->getName());
+    }
+    rules.push_back(record);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = FormatVersion;
+  header.keySize = key.size();
+  std::memcpy(header.key, key.constData(), key.size());
+  header.classCount = classes.size();
+  header.ruleCount = rules.size();
+  header.actionCount = actions.size();
+  header.loopCount = loops.size();
+  header.stringsSize = strings.size();
+  header.startRule = ruleIndices.at(ruleSet.topLevelRule);
+  header.recurseDepthFirst = ruleSet.recurseDepth;
+  header.meshReachable = ruleSet.meshReachable;
+
+  QByteArray out;
+  out.append(reinterpret_cast<const char*>(&header), int(sizeof(header)));
+  append(out, classes);
+  append(out, rules);
+  append(out, actions);
+  append(out, loops);
+  out.append(strings);
+  return out;
+}
+
+auto RuleSetCache::deserialize(const char* data, std::size_t size, const QByteArray& key)
+    -> RuleSet*
+{
+  Header header;
+  if (size < sizeof(header))
+    return nullptr;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+      || header.version != FormatVersion || header.keySize != key.size()
+      || std::memcmp(header.key, key.constData(), key.size()) != 0)
+    return nullptr;
+
+  // The records are read in place.
+  if (reinterpret_cast<uintptr_t>(data) % alignof(double) != 0)
+  {
+    WARNING("Misaligned RuleSet cache data.");
+    return nullptr;
+  }
+  const uint64_t expectedSize
+      = sizeof(Header) + uint64_t(header.classCount) * sizeof(ClassRecord)
+        + uint64_t(header.ruleCount) * sizeof(RuleRecord)
+        + uint64_t(header.actionCount) * sizeof(ActionRecord)
+        + uint64_t(header.loopCount) * sizeof(LoopRecord) + header.stringsSize;
+  if (expectedSize != size || header.classCount == 0)
+  {
+    WARNING("Invalid RuleSet cache data.");
+    return nullptr;
+  }
+
+  const char* p = data + sizeof(Header);
+  auto* classes = reinterpret_cast<const ClassRecord*>(p);
+  p += header.classCount * sizeof(ClassRecord);
+  auto* rules = reinterpret_cast<const RuleRecord*>(p);
+  p += header.ruleCount * sizeof(RuleRecord);
+  auto* actions = reinterpret_cast<const ActionRecord*>(p);
+  p += header.actionCount * sizeof(ActionRecord);
+  auto* loops = reinterpret_cast<const LoopRecord*>(p);
+  p += header.loopCount * sizeof(LoopRecord);
+  const char* strings = p;
+
+  // Checks all the indices first, so the RuleSet can be built without failing.
+  auto isValidString = [&](const StringRecord& s)
+  { return isValidRange(s.offset, s.size, header.stringsSize); };
+  auto isValidRule = [&](int32_t rule)
+  { return rule >= 0 && uint32_t(rule) < header.ruleCount; };
+  bool valid
+      = isValidRule(header.startRule) && rules[header.startRule].kind == CustomKind;
+  for (uint32_t i = 0; valid && i < header.classCount; i++)
+    valid = isValidString(classes[i].name);
+  for (uint32_t i = 0; valid && i < header.actionCount; i++)
+  {
+    const ActionRecord& a = actions[i];
+    valid = isValidRange(a.firstLoop, a.loopCount, header.loopCount)
+            && isValidString(a.ruleName) && isValidString(a.setKey)
+            && isValidString(a.setValue) && (a.rule == -1 || isValidRule(a.rule));
+  }
+  std::vector<bool> claimed(header.ruleCount);
+  for (uint32_t i = 0; valid && i < header.ruleCount; i++)
+  {
+    const RuleRecord& r = rules[i];
+    valid = isValidString(r.name) && isValidString(r.retirementName)
+            && r.owner <= ResolvedOwner;
+    if (r.kind == PrimitiveKind || r.kind == TriangleKind)
+      valid = valid && r.primitiveClass >= 0
+              && uint32_t(r.primitiveClass) < header.classCount
+              && r.primitiveType <= PrimitiveRule::Other;
+    else if (r.kind == CustomKind)
+      valid = valid && isValidRange(r.first, r.count, header.actionCount)
+              && (r.retirementRule == -1 || isValidRule(r.retirementRule));
+    else if (r.kind == AmbiguousKind)
+    {
+      valid = valid && isValidRange(r.first, r.count, header.ruleCount);
+      for (uint32_t j = r.first; valid && j < r.first + r.count; j++)
+      {
+        valid = rules[j].kind == CustomKind && rules[j].owner == AmbiguousRuleOwner
+                && !claimed[j];
+        claimed[j] = true;
+      }
+    }
+    else
+      valid = false;
+  }
+  // Every definition must belong to exactly one ambiguous rule.
+  for (uint32_t i = 0; valid && i < header.ruleCount; i++)
+    valid = claimed[i] == (rules[i].owner == AmbiguousRuleOwner);
+  if (!valid)
+  {
+    WARNING("Invalid RuleSet cache data.");
+    return nullptr;
+  }
+
+  auto string = [&](const StringRecord& s)
+  { return QString::fromUtf8(strings + s.offset, int(s.size)); };
+
+  auto ruleSet = std::make_unique<RuleSet>();
+  for (Rule* rule : ruleSet->rules)
+    delete rule;
+  ruleSet->rules.clear();
+
+  std::vector<PrimitiveClass*> primitiveClasses;
+  for (uint32_t i = 0; i < header.classCount; i++)
+  {
+    const ClassRecord& record = classes[i];
+    PrimitiveClass* c = i == 0 ? ruleSet->defaultClass : new PrimitiveClass();
+    c->name = string(record.name);
+    c->reflection = record.reflection;
+    c->ambient = record.ambient;
+    c->specular = record.specular;
+    c->diffuse = record.diffuse;
+    c->hasShadows = record.hasShadows;
+    c->castShadows = record.castShadows;
+    if (i != 0)
+      ruleSet->primitiveClasses.push_back(c);
+    primitiveClasses.push_back(c);
+  }
+
+  std::vector<Rule*> allRules;
+  for (uint32_t i = 0; i < header.ruleCount; i++)
+  {
+    const RuleRecord& record = rules[i];
+    Rule* rule = nullptr;
+    switch (record.kind)
+    {
+      case PrimitiveKind:
+        rule = new PrimitiveRule(
+            PrimitiveRule::PrimitiveType(record.primitiveType),
+            primitiveClasses[record.primitiveClass]);
+        break;
+      case TriangleKind:
+      {
+        const float* v = record.points;
+        rule = new TriangleRule(
+            Vector3f(v[0], v[1], v[2]),
+            Vector3f(v[3], v[4], v[5]),
+            Vector3f(v[6], v[7], v[8]),
+            primitiveClasses[record.primitiveClass]);
+        break;
+      }
+      case CustomKind:
+      {
+        auto* cr = new CustomRule(string(record.name));
+        cr->setWeight(record.weight);
+        rule = cr;
+        break;
+      }
+      default:
+        rule = new AmbiguousRule(string(record.name));
+        break;
+    }
+    // The max. depth of an ambiguous rule is not propagated to its definitions here.
+    rule->Rule::setMaxDepth(record.maxDepth);
+    rule->setDepthId(record.depthId);
+
+    if (record.owner == RuleSetOwner)
+      ruleSet->rules.push_back(rule);
+    else if (record.owner == ResolvedOwner)
+      ruleSet->resolvedRules.push_back(rule);
+    allRules.push_back(rule);
+  }
+
+  for (uint32_t i = 0; i < header.ruleCount; i++)
+  {
+    const RuleRecord& record = rules[i];
+    if (record.kind == CustomKind)
+    {
+      auto* cr = static_cast<CustomRule*>(allRules[i]);
+      for (uint32_t a = record.first; a < record.first + record.count; a++)
+      {
+        const ActionRecord& ar = actions[a];
+        Action action;
+        if (ar.isSet)
+          action = Action(string(ar.setKey), string(ar.setValue));
+        else if (ar.rule != -1)
+        {
+          action.setRule(string(ar.ruleName));
+          action.getRuleRef()->setRef(allRules[ar.rule]);
+        }
+        for (uint32_t l = ar.firstLoop; l < ar.firstLoop + ar.loopCount; l++)
+        {
+          const LoopRecord& lr = loops[l];
+          Transformation t;
+          for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 4; col++)
+              t.matrix(row, col) = lr.matrix[row * 4 + col];
+          t.deltaH = lr.deltaH;
+          t.scaleS = lr.scaleS;
+          t.scaleV = lr.scaleV;
+          t.scaleAlpha = lr.scaleAlpha;
+          t.absoluteColor = lr.absoluteColor;
+          if (lr.blendColorValid)
+            t.blendColor = QColor::fromRgba(lr.blendColor);
+          t.strength = lr.strength;
+          action.addTransformationLoop(TransformationLoop(lr.repetitions, t));
+        }
+        cr->appendAction(action);
+      }
+      if (record.retirementRule != -1)
+      {
+        cr->setRetirementRule(string(record.retirementName));
+        cr->getRetirementRule()->setRef(allRules[record.retirementRule]);
+      }
+    }
+    else if (record.kind == AmbiguousKind)
+    {
+      auto* ar = static_cast<AmbiguousRule*>(allRules[i]);
+      for (uint32_t j = record.first; j < record.first + record.count; j++)
+        ar->appendRule(static_cast<CustomRule*>(allRules[j]));
+      ar->buildSelectionTable();
+    }
+  }
+
+  ruleSet->indexRules();
+  ruleSet->topLevelRule = static_cast<CustomRule*>(allRules[header.startRule]);
+  ruleSet->recurseDepth = header.recurseDepthFirst;
+  ruleSet->meshReachable = header.meshReachable;
+  return ruleSet.release();
+}
+
+}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+
+namespace ssynth
+{
+namespace Model
+{
+
+class RuleSet; // forward decl.
+
+/// An on-disk cache of resolved RuleSets, so an unchanged script is not tokenized,
+/// parsed and resolved again.
+///
+/// The entries are keyed by a hash of the preprocessed script (the preprocessing is
+/// cheap, and expands the 'random[a,b]' statements, which depend on the seed).
+/// The RuleSet must be stored right after 'RuleSet::resolveNames', since building a
+/// structure changes the max. depths and the primitive classes.
+///
+/// An entry is a flat array of fixed-size records (rules, actions, loops, primitive
+/// classes, and the strings as UTF-8), referring to each other by index: it is memory
+/// mapped and read in place, without any parsing. The format uses the native byte
+/// order, so the cache should not be shared between machines.
+class RuleSetCache
+{
+public:
+  /// The cache files are stored in 'directory' (created if missing).
+  explicit RuleSetCache(const QString& directory);
+
+  /// Returns the RuleSet stored for 'script' (owned by the caller), or nullptr.
+  /// Invalid or outdated entries are ignored (and replaced by the next 'store').
+  RuleSet* load(const QString& script) const;
+
+  /// Stores 'ruleSet', parsed from 'script' and resolved. Failures are only logged.
+  void store(const QString& script, const RuleSet& ruleSet) const;
+
+  /// The serialized form of a resolved RuleSet.
+  /// 'key' is stored in the header, and checked by 'deserialize'.
+  static QByteArray serialize(const RuleSet& ruleSet, const QByteArray& key);
+
+  /// Rebuilds a RuleSet serialized with the same 'key', or returns nullptr.
+  static RuleSet* deserialize(const char* data, std::size_t size, const QByteArray& key);
+
+private:
+  static QByteArray keyOf(const QString& script);
+  QString fileOf(const QByteArray& key) const;
+
+  QString directory;
+};
+
+}
+}
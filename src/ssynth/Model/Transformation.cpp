@@ -1,3 +1,4 @@
+#include <ssynth/AffineMatrix4.h>
 #include <ssynth/ColorPool.h>
 #include <ssynth/Exception.h>
 #include <ssynth/Logging.h>
@@ -23,7 +24,7 @@ Transformation::Transformation()
     , absoluteColor(false)
     , strength(0)
 {
-  matrix = Matrix4f::Identity();
+  matrix = AffineMatrix4f::Identity();
 }
 
 Transformation::~Transformation() = default;
@@ -33,29 +34,39 @@ auto Transformation::apply(const State& s, ColorPool* colorPool) const -> State
 {
   State s2(s);
   s2.matrix = s.matrix * matrix;
+  applyColor(s2, colorPool);
+  return s2;
+}
 
+void Transformation::applyColor(State& s2, ColorPool* colorPool) const
+{
+  if (drawsRandomColor())
+  {
+    QColor c = colorPool->drawColor(s2.random.Color());
+    s2.hsv = Vector3f(c.hue(), c.saturation() / 255.0, c.value() / 255.0);
+    s2.alpha = 1.0;
+    applyBlend(s2.hsv);
+  }
+  else
+  {
+    applyColor(s2.hsv, s2.alpha);
+  }
+}
+
+void Transformation::applyColor(Vector3f& hsv, float& alpha) const
+{
+  Q_ASSERT(!drawsRandomColor());
   if (absoluteColor)
   {
-    // if the absolute hue is larger than 360, we will choose a random color.
-    if (deltaH > 360)
-    {
-
-      QColor c = colorPool->drawColor();
-      s2.hsv = Vector3f(c.hue(), c.saturation() / 255.0, c.value() / 255.0);
-      s2.alpha = 1.0;
-    }
-    else
-    {
-      s2.hsv = Vector3f(deltaH, scaleS, scaleV);
-      s2.alpha = scaleAlpha;
-    }
+    hsv = Vector3f(deltaH, scaleS, scaleV);
+    alpha = scaleAlpha;
   }
   else
   {
-    float h = s2.hsv[0] + deltaH;
-    float sat = s2.hsv[1] * scaleS;
-    float v = s2.hsv[2] * scaleV;
-    float a = s2.alpha * scaleAlpha;
+    float h = hsv[0] + deltaH;
+    float sat = hsv[1] * scaleS;
+    float v = hsv[2] * scaleV;
+    float a = alpha * scaleAlpha;
     if (sat < 0)
       sat = 0;
     if (v < 0)
@@ -72,60 +83,63 @@ auto Transformation::apply(const State& s, ColorPool* colorPool) const -> State
       h -= 360;
     while (h < 0)
       h += 360;
-    s2.hsv = Vector3f(h, sat, v);
-    s2.alpha = a;
+    hsv = Vector3f(h, sat, v);
+    alpha = a;
   }
 
-  if (strength)
-  {
-    /*
-                // We will blend the two colors (in RGB space)
-                QColor original = QColor::fromHsv((int)(s2.hsv[0]),(int)(s2.hsv[1]*255.0),(int)(s2.hsv[2]*255.0));
-                double r = original.red() + strength*blendColor.red();
-                double g = original.green() + strength*blendColor.green();
-                double b = original.blue() + strength*blendColor.blue();
-                if (r<0) r=0;
-                if (g<0) g=0;
-                if (b<0) b=0;
-                double max = r;
-                if (g>max) max = g;
-                if (b>max) max = b;
-                if (max > 255) {
-                    r = r * 255 / max;
-                    g = g * 255 / max;
-                    b = b * 255 / max;
-                }
-
-                QColor mixed(r,g,b);
-
-
-                s2.hsv = Vector3f(mixed.hue(), mixed.saturation()/255.0,mixed.value()/255.0);
-                */
-
-    // We will blend the two colors (in HSV space)
-    Vector3f bl = Vector3f(
-        blendColor.hue(), blendColor.saturation() / 255.0, blendColor.value() / 255.0);
-    Vector3f b(
-        s2.hsv[0] + strength * bl[0],
-        s2.hsv[1] + strength * bl[1],
-        s2.hsv[2] + strength * bl[2]);
-    b = b / (1 + strength);
-    while (b[0] < 0)
-      b[0] += 360;
-    while (b[0] > 360)
-      b[0] -= 360;
-    if (b[1] > 1)
-      b[1] = 1;
-    if (b[2] > 1)
-      b[2] = 1;
-    if (b[1] < 0)
-      b[1] = 0;
-    if (b[2] < 0)
-      b[2] = 0;
-    s2.hsv = b;
-  }
+  applyBlend(hsv);
+}
 
-  return s2;
+void Transformation::applyBlend(Vector3f& hsv) const
+{
+  if (!strength)
+    return;
+
+  /*
+              // We will blend the two colors (in RGB space)
+              QColor original = QColor::fromHsv((int)(hsv[0]),(int)(hsv[1]*255.0),(int)(hsv[2]*255.0));
+              double r = original.red() + strength*blendColor.red();
+              double g = original.green() + strength*blendColor.green();
+              double b = original.blue() + strength*blendColor.blue();
+              if (r<0) r=0;
+              if (g<0) g=0;
+              if (b<0) b=0;
+              double max = r;
+              if (g>max) max = g;
+              if (b>max) max = b;
+              if (max > 255) {
+                  r = r * 255 / max;
+                  g = g * 255 / max;
+                  b = b * 255 / max;
+              }
+
+              QColor mixed(r,g,b);
+
+
+              hsv = Vector3f(mixed.hue(), mixed.saturation()/255.0,mixed.value()/255.0);
+              */
+
+  // We will blend the two colors (in HSV space)
+  Vector3f bl = Vector3f(
+      blendColor.hue(), blendColor.saturation() / 255.0, blendColor.value() / 255.0);
+  Vector3f b(
+      hsv[0] + strength * bl[0],
+      hsv[1] + strength * bl[1],
+      hsv[2] + strength * bl[2]);
+  b = b / (1 + strength);
+  while (b[0] < 0)
+    b[0] += 360;
+  while (b[0] > 360)
+    b[0] -= 360;
+  if (b[1] > 1)
+    b[1] = 1;
+  if (b[2] > 1)
+    b[2] = 1;
+  if (b[1] < 0)
+    b[1] = 0;
+  if (b[2] < 0)
+    b[2] = 0;
+  hsv = b;
 }
 
 void Transformation::append(const Transformation& t)
@@ -186,7 +200,7 @@ auto Transformation::createZ(double offset) -> Transformation
 auto Transformation::createPlaneReflection(Math::Vector3f normal) -> Transformation
 {
   Transformation t;
-  t.matrix = Matrix4f::PlaneReflection(normal);
+  t.matrix = AffineMatrix4f(Matrix4f::PlaneReflection(normal));
   return t;
 }
 
@@ -194,29 +208,30 @@ auto Transformation::createPlaneReflection(Math::Vector3f normal) -> Transformat
 auto Transformation::createRX(double angle) -> Transformation
 {
   Transformation t;
-  t.matrix = Matrix4f::Translation(0, 0.5, 0.5)
-             * Matrix4f::Rotation(Vector3f(1, 0, 0), angle)
-             * Matrix4f::Translation(0, -0.5, -0.5);
+  t.matrix = AffineMatrix4f(
+      Matrix4f::Translation(0, 0.5, 0.5)
+      * Matrix4f::Rotation(Vector3f(1, 0, 0), angle)
+      * Matrix4f::Translation(0, -0.5, -0.5));
   return t;
 }
 
 auto Transformation::createRY(double angle) -> Transformation
 {
   Transformation t;
-  t.matrix = Matrix4f::Translation(0.5, 0, 0.5)
-             * Matrix4f::Rotation(Vector3f(0, 1, 0), angle)
-             * Matrix4f::Translation(-0.5, 0, -0.5)
-
-      ;
+  t.matrix = AffineMatrix4f(
+      Matrix4f::Translation(0.5, 0, 0.5)
+      * Matrix4f::Rotation(Vector3f(0, 1, 0), angle)
+      * Matrix4f::Translation(-0.5, 0, -0.5));
   return t;
 }
 
 auto Transformation::createRZ(double angle) -> Transformation
 {
   Transformation t;
-  t.matrix = Matrix4f::Translation(0.5, 0.5, 0)
-             * Matrix4f::Rotation(Vector3f(0, 0, 1), angle)
-             * Matrix4f::Translation(-0.5, -0.5, 0);
+  t.matrix = AffineMatrix4f(
+      Matrix4f::Translation(0.5, 0.5, 0)
+      * Matrix4f::Rotation(Vector3f(0, 0, 1), angle)
+      * Matrix4f::Translation(-0.5, -0.5, 0));
   return t;
 }
 
@@ -268,28 +283,32 @@ auto Transformation::createBlend(const QString& color, double strength) -> Trans
 auto Transformation::createScale(double x, double y, double z) -> Transformation
 {
   Transformation t;
-  t.matrix(0, 0) = x;
-  t.matrix(1, 1) = y;
-  t.matrix(2, 2) = z;
-  t.matrix = Matrix4f::Translation(0.5, 0.5, 0.5) * t.matrix
-             * Matrix4f::Translation(-0.5, -0.5, -0.5);
+  Matrix4f m = Matrix4f::Identity();
+  m(0, 0) = x;
+  m(1, 1) = y;
+  m(2, 2) = z;
+  t.matrix = AffineMatrix4f(
+      Matrix4f::Translation(0.5, 0.5, 0.5) * m
+      * Matrix4f::Translation(-0.5, -0.5, -0.5));
   return t;
 }
 
 auto Transformation::createMatrix(const std::vector<double>& vals) -> Transformation
 {
   Transformation t;
-  t.matrix(0, 0) = vals[0];
-  t.matrix(0, 1) = vals[1];
-  t.matrix(0, 2) = vals[2];
-  t.matrix(1, 0) = vals[3];
-  t.matrix(1, 1) = vals[4];
-  t.matrix(1, 2) = vals[5];
-  t.matrix(2, 0) = vals[6];
-  t.matrix(2, 1) = vals[7];
-  t.matrix(2, 2) = vals[8];
-  t.matrix = Matrix4f::Translation(0.5, 0.5, 0.5) * t.matrix
-             * Matrix4f::Translation(-0.5, -0.5, -0.5);
+  Matrix4f m = Matrix4f::Identity();
+  m(0, 0) = vals[0];
+  m(0, 1) = vals[1];
+  m(0, 2) = vals[2];
+  m(1, 0) = vals[3];
+  m(1, 1) = vals[4];
+  m(1, 2) = vals[5];
+  m(2, 0) = vals[6];
+  m(2, 1) = vals[7];
+  m(2, 2) = vals[8];
+  t.matrix = AffineMatrix4f(
+      Matrix4f::Translation(0.5, 0.5, 0.5) * m
+      * Matrix4f::Translation(-0.5, -0.5, -0.5));
   return t;
 }
 
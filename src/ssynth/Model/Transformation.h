@@ -1,7 +1,7 @@
 #pragma once
 
+#include <ssynth/AffineMatrix4.h>
 #include <ssynth/ColorPool.h>
-#include <ssynth/Matrix4.h>
 #include <ssynth/Model/State.h>
 #include <ssynth/Vector3.h>
 
@@ -24,6 +24,24 @@ public:
   void append(const Transformation& T);
   State apply(const State& s, ColorPool* colorPool) const;
 
+  /// Applies only the color part of the transformation to 's' (in place).
+  void applyColor(State& s, ColorPool* colorPool) const;
+  /// Applies the color part to a color (the transformation must not draw random colors).
+  void applyColor(Math::Vector3f& hsv, float& alpha) const;
+
+  /// True if the color part draws a random color (from the color pool).
+  bool drawsRandomColor() const { return absoluteColor && deltaH > 360; }
+
+  /// False if the color part only normalizes the color, i.e. applying it more than
+  /// once gives the same result as applying it once.
+  bool changesColor() const
+  {
+    return absoluteColor || deltaH != 0 || scaleS != 1 || scaleV != 1 || scaleAlpha != 1
+           || strength != 0;
+  }
+
+  const Math::AffineMatrix4f& getMatrix() const { return matrix; }
+
   // The predefined operators
   // Translations
   static Transformation createX(double offset);
@@ -50,8 +68,12 @@ public:
   static Transformation createBlend(const QString& color, double strength);
 
 private:
+  friend class RuleSetCache;
+
+  void applyBlend(Math::Vector3f& hsv) const;
+
   // Matrix and Color transformations here.
-  Math::Matrix4f matrix;
+  Math::AffineMatrix4f matrix;
 
   // For color alterations
   float deltaH;
@@ -72,30 +72,93 @@ auto EisenParser::accept(Symbol::SymbolType st) -> bool
   return false;
 }
 
+namespace
+{
+double defaultValueOf(GuiParameter* parameter)
+{
+  if (auto* fp = dynamic_cast<FloatParameter*>(parameter))
+    return fp->getDefaultValue();
+  return static_cast<IntParameter*>(parameter)->getDefaultValue();
+}
+}
+
+void EisenParser::setParameters(const std::vector<GuiParameter*>& parameters)
+{
+  this->parameters = parameters;
+  parameterSlots.clear();
+  for (int i = 0; i < parameters.size(); i++)
+    parameterSlots[parameters[i]->getName().toLower()] = i; // The last one wins.
+}
+
+auto EisenParser::isNumber() const -> bool
+{
+  return symbol.type == Symbol::Number
+         || (symbol.type == Symbol::UserString && !parameterSlots.empty()
+             && parameterSlots.count(symbol.getText()));
+}
+
+auto EisenParser::isLoopCount() -> bool
+{
+  // A GUI parameter not followed by '*' is a rule name.
+  return symbol.type == Symbol::Number
+         || (isNumber() && tokenizer.peekSymbol().type == Symbol::Multiply);
+}
+
+auto EisenParser::acceptNumber(double& value, int& slot) -> bool
+{
+  slot = -1;
+  if (symbol.type == Symbol::UserString && !parameterSlots.empty())
+  {
+    auto it = parameterSlots.find(symbol.getText());
+    if (it == parameterSlots.end())
+      return false;
+    slot = it->second;
+    value = defaultValueOf(parameters[slot]);
+    getSymbol();
+    return true;
+  }
+  value = symbol.getNumerical();
+  return accept(Symbol::Number);
+}
+
+void EisenParser::appendAction(CustomRule* customRule, const Action& action)
+{
+  for (ParametricLoop& loop : actionLoops)
+  {
+    loop.rule = customRule;
+    loop.action = customRule->getActions().size();
+    parametricLoops.push_back(std::move(loop));
+  }
+  actionLoops.clear();
+  customRule->appendAction(action);
+}
+
 void EisenParser::ruleModifierList(CustomRule* customRule)
 {
   while (symbol.type == Symbol::Operator)
   {
-    if (symbol.text == "weight")
+    if (symbol.op == Symbol::Weight)
     {
       getSymbol();
       double param = symbol.getNumerical();
       if (!accept(Symbol::Number))
       {
         throw(ParseError(
-            "Rule modifier 'weight' expected numerical argument. Found: " + symbol.text,
+            "Rule modifier 'weight' expected numerical argument. Found: "
+                + symbol.getText(),
             symbol.pos));
       }
       customRule->setWeight(param);
     }
-    else if (symbol.text == "maxdepth")
+    else if (symbol.op == Symbol::MaxDepth)
     {
       getSymbol();
       int param = (int)symbol.getNumerical();
       if (!symbol.isInteger || !accept(Symbol::Number))
       {
         throw(ParseError(
-            "Rule modifier 'maxdepth' expected integer argument. Found: " + symbol.text,
+            "Rule modifier 'maxdepth' expected integer argument. Found: "
+                + symbol.getText(),
             symbol.pos));
       }
       customRule->setMaxDepth(param);
@@ -103,11 +166,11 @@ void EisenParser::ruleModifierList(CustomRule* customRule)
       if (symbol.type == Symbol::MoreThan)
       {
         getSymbol();
-        QString ruleName = symbol.text;
+        QString ruleName = symbol.getText();
         if (!accept(Symbol::UserString))
           throw(ParseError(
               "After maxdepth retirement operator a rule name is expected. Found: "
-                  + symbol.text,
+                  + symbol.getText(),
               symbol.pos));
         customRule->setRetirementRule(ruleName);
       }
@@ -115,7 +178,8 @@ void EisenParser::ruleModifierList(CustomRule* customRule)
     else
     {
       throw(ParseError(
-          "In rule modifier list: expected maxdepth or weight. Found: " + symbol.text,
+          "In rule modifier list: expected maxdepth or weight. Found: "
+              + symbol.getText(),
           symbol.pos));
     }
   }
@@ -123,7 +187,7 @@ void EisenParser::ruleModifierList(CustomRule* customRule)
   if (symbol.type != Symbol::LeftBracket)
   {
     throw(ParseError(
-        "After rule modifier list: expected a left bracket. Found: " + symbol.text,
+        "After rule modifier list: expected a left bracket. Found: " + symbol.getText(),
         symbol.pos));
   }
 }
@@ -135,13 +199,13 @@ auto EisenParser::rule() -> Rule*
   if (!accept(Symbol::Rule))
     throw(ParseError(
         "Unexpected: trying to parse Rule not starting with rule identifier. Found: "
-            + symbol.text,
+            + symbol.getText(),
         symbol.pos));
 
-  QString ruleName = symbol.text;
+  QString ruleName = symbol.getText();
   if (!accept(Symbol::UserString))
     throw(ParseError(
-        "After rule identifier a rule name is expected. Found: " + symbol.text,
+        "After rule identifier a rule name is expected. Found: " + symbol.getText(),
         symbol.pos));
   auto* customRule = new CustomRule(ruleName);
 
@@ -153,7 +217,7 @@ auto EisenParser::rule() -> Rule*
 
   if (!accept(Symbol::LeftBracket))
     throw(ParseError(
-        "After rule name a left bracket is expected. Found: " + symbol.text,
+        "After rule name a left bracket is expected. Found: " + symbol.getText(),
         symbol.pos));
 
   // TODO: implement rest of types:
@@ -169,18 +233,18 @@ auto EisenParser::rule() -> Rule*
     if (symbol.type == Symbol::Set)
     {
       Action a = setAction();
-      customRule->appendAction(a);
+      appendAction(customRule, a);
     }
     else
     {
       Action a = action();
-      customRule->appendAction(a);
+      appendAction(customRule, a);
     }
   }
 
   if (!accept(Symbol::RightBracket))
     throw(ParseError(
-        "A rule definition must end with a right bracket. Found: " + symbol.text,
+        "A rule definition must end with a right bracket. Found: " + symbol.getText(),
         symbol.pos));
 
   return customRule;
@@ -194,217 +258,167 @@ auto degreeToRad(double degrees) -> double
 auto EisenParser::transformation() -> Transformation
 {
 
-  QString type = symbol.text;
+  const Symbol type = symbol;
   if (!accept(Symbol::Operator))
     throw(ParseError(
         "Transformation: Expected transformation identifier (e.g. 'x' or 'rx'). Found: "
-            + symbol.text,
+            + symbol.getText(),
         symbol.pos));
 
-  if (type == "x")
+  ParametricOperator o{type.op};
+  auto number = [&](const QString& error)
   {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'X' (X-axis translation): Expected numerical parameter. "
-          "Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createX(param);
-  }
-  else if (type == "y")
+    double param = 0;
+    int slot = -1;
+    if (!acceptNumber(param, slot))
+      throw(ParseError(error + symbol.getText(), symbol.pos));
+    o.arguments.push_back(param);
+    o.slots.push_back(slot);
+  };
+
+  switch (type.op)
   {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
+    case Symbol::X:
+      number(
+          "Transformation 'X' (X-axis translation): Expected numerical parameter. "
+          "Found: ");
+      break;
+    case Symbol::Y:
+      number(
           "Transformation 'Y' (Y-axis translation): Expected numerical parameter. "
-          "Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createY(param);
-  }
-  else if (type == "z")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
+          "Found: ");
+      break;
+    case Symbol::Z:
+      number(
           "Transformation 'Z' (Z-axis translation): Expected numerical parameter. "
-          "Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createZ(param);
-  }
-  else if (type == "rx")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'RX' (X-axis rotation): Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createRX(degreeToRad(param));
-  }
-  else if (type == "ry")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'RY' (Y-axis rotation): Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createRY(degreeToRad(param));
-  }
-  else if (type == "rz")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'RZ' (Z-axis rotation): Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createRZ(degreeToRad(param));
-  }
-  else if (type == "hue")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'hue': Expected numerical parameter. Found: " + symbol.text,
-          symbol.pos));
-    return Transformation::createHSV(param, 1, 1, 1);
-  }
-  else if (type == "sat")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'sat': Expected numerical parameter. Found: " + symbol.text,
-          symbol.pos));
-    return Transformation::createHSV(0, param, 1, 1);
-  }
-  else if (type == "brightness")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'brightness': Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createHSV(0, 1, param, 1);
-  }
-  else if (type == "color")
-  {
-    QString param = symbol.text;
-    if (!QColor(param).isValid() && param.toLower() != "random")
-      throw(ParseError(
-          "Transformation 'color': Expected a valid color. Found: " + symbol.text,
-          symbol.pos));
-    getSymbol();
-    return Transformation::createColor(param);
-  }
-  else if (type == "blend")
-  {
-    QString param = symbol.text;
-    if (!QColor(param).isValid())
-      throw(ParseError(
-          "Transformation 'blend': Expected a valid color as first argument. Found: "
-              + symbol.text,
-          symbol.pos));
-    getSymbol();
-    double param2 = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'blend': Expected a numerical value as second argument. "
-          "Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createBlend(param, param2);
-  }
-  else if (type == "alpha")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'alpha': Expected numerical parameter. Found: " + symbol.text,
-          symbol.pos));
-    return Transformation::createHSV(0, 1, 1, param);
-  }
-  else if (type == "matrix")
-  {
-    std::vector<double> ds;
-    for (unsigned int i = 0; i < 9; i++)
-    {
-      double param = symbol.getNumerical();
-      if (!accept(Symbol::Number))
+          "Found: ");
+      break;
+    case Symbol::RX:
+      number(
+          "Transformation 'RX' (X-axis rotation): Expected numerical parameter. "
+          "Found: ");
+      break;
+    case Symbol::RY:
+      number(
+          "Transformation 'RY' (Y-axis rotation): Expected numerical parameter. "
+          "Found: ");
+      break;
+    case Symbol::RZ:
+      number(
+          "Transformation 'RZ' (Z-axis rotation): Expected numerical parameter. "
+          "Found: ");
+      break;
+    case Symbol::Hue:
+      number("Transformation 'hue': Expected numerical parameter. Found: ");
+      break;
+    case Symbol::Sat:
+      number("Transformation 'sat': Expected numerical parameter. Found: ");
+      break;
+    case Symbol::Brightness:
+      number("Transformation 'brightness': Expected numerical parameter. Found: ");
+      break;
+    case Symbol::Color:
+      o.color = symbol.getText();
+      if (!QColor(o.color).isValid() && o.color.toLower() != "random")
         throw(ParseError(
-            "Transformation 'matrix': Expected nine (9) parameters. Found: "
-                + symbol.text,
+            "Transformation 'color': Expected a valid color. Found: " + symbol.getText(),
             symbol.pos));
-      ds.push_back(param);
-    }
-    return Transformation::createMatrix(ds);
-  }
-  else if (type == "s")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'S' (size): Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-
-    if (symbol.type == Symbol::Number)
-    {
-      double param2 = symbol.getNumerical();
       getSymbol();
-      double param3 = symbol.getNumerical();
-      if (!accept(Symbol::Number))
+      break;
+    case Symbol::Blend:
+      o.color = symbol.getText();
+      if (!QColor(o.color).isValid())
         throw(ParseError(
-            "Transformation 'S' (size): Expected third numerical parameter. Found: "
-                + symbol.text,
+            "Transformation 'blend': Expected a valid color as first argument. Found: "
+                + symbol.getText(),
             symbol.pos));
-      return Transformation::createScale(param, param2, param3);
-    }
-    return Transformation::createScale(param, param, param);
+      getSymbol();
+      number(
+          "Transformation 'blend': Expected a numerical value as second argument. "
+          "Found: ");
+      break;
+    case Symbol::Alpha:
+      number("Transformation 'alpha': Expected numerical parameter. Found: ");
+      break;
+    case Symbol::Matrix:
+      for (unsigned int i = 0; i < 9; i++)
+        number("Transformation 'matrix': Expected nine (9) parameters. Found: ");
+      break;
+    case Symbol::S:
+      number("Transformation 'S' (size): Expected numerical parameter. Found: ");
+      if (isNumber())
+      {
+        number("");
+        number("Transformation 'S' (size): Expected third numerical parameter. Found: ");
+      }
+      break;
+    case Symbol::Reflect:
+      number("Transformation 'reflect': Expected numerical parameter. Found: ");
+      number("Transformation 'reflect': Expected second numerical parameter. Found: ");
+      number("Transformation 'reflect': Expected third numerical parameter. Found: ");
+      break;
+    case Symbol::FX:
+    case Symbol::FY:
+    case Symbol::FZ:
+      break;
+    default:
+      throw(ParseError("Unknown transformation type: " + type.getText(), symbol.pos));
   }
-  else if (type == "reflect")
-  {
-    double param = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'reflect': Expected numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
 
-    double param2 = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'reflect': Expected second numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    double param3 = symbol.getNumerical();
-    if (!accept(Symbol::Number))
-      throw(ParseError(
-          "Transformation 'reflect': Expected third numerical parameter. Found: "
-              + symbol.text,
-          symbol.pos));
-    return Transformation::createPlaneReflection(Math::Vector3f(param, param2, param3));
-  }
-  else if (type == "fx")
-  {
-    return Transformation::createScale(-1, 1, 1);
-  }
-  else if (type == "fy")
-  {
-    return Transformation::createScale(1, -1, 1);
-  }
-  else if (type == "fz")
-  {
-    return Transformation::createScale(1, 1, -1);
-  }
-  else
+  Transformation t = createTransformation(o.op, o.arguments, o.color);
+  operators.push_back(std::move(o));
+  return t;
+}
+
+auto EisenParser::createTransformation(
+    Symbol::OperatorType op,
+    const std::vector<double>& arguments,
+    const QString& color) -> Transformation
+{
+  switch (op)
   {
-    throw(ParseError("Unknown transformation type: " + type, symbol.pos));
+    case Symbol::X:
+      return Transformation::createX(arguments[0]);
+    case Symbol::Y:
+      return Transformation::createY(arguments[0]);
+    case Symbol::Z:
+      return Transformation::createZ(arguments[0]);
+    case Symbol::RX:
+      return Transformation::createRX(degreeToRad(arguments[0]));
+    case Symbol::RY:
+      return Transformation::createRY(degreeToRad(arguments[0]));
+    case Symbol::RZ:
+      return Transformation::createRZ(degreeToRad(arguments[0]));
+    case Symbol::Hue:
+      return Transformation::createHSV(arguments[0], 1, 1, 1);
+    case Symbol::Sat:
+      return Transformation::createHSV(0, arguments[0], 1, 1);
+    case Symbol::Brightness:
+      return Transformation::createHSV(0, 1, arguments[0], 1);
+    case Symbol::Color:
+      return Transformation::createColor(color);
+    case Symbol::Blend:
+      return Transformation::createBlend(color, arguments[0]);
+    case Symbol::Alpha:
+      return Transformation::createHSV(0, 1, 1, arguments[0]);
+    case Symbol::Matrix:
+      return Transformation::createMatrix(arguments);
+    case Symbol::S:
+      if (arguments.size() == 3)
+        return Transformation::createScale(arguments[0], arguments[1], arguments[2]);
+      return Transformation::createScale(arguments[0], arguments[0], arguments[0]);
+    case Symbol::Reflect:
+      return Transformation::createPlaneReflection(
+          Math::Vector3f(arguments[0], arguments[1], arguments[2]));
+    case Symbol::FX:
+      return Transformation::createScale(-1, 1, 1);
+    case Symbol::FY:
+      return Transformation::createScale(1, -1, 1);
+    case Symbol::FZ:
+      return Transformation::createScale(1, 1, -1);
+    default:
+      // Not a transformation operator.
+      return {};
   }
 }
 
@@ -414,10 +428,11 @@ auto EisenParser::transformationList() -> Transformation
   // { x 23 rx 23 }
 
   Transformation t;
+  operators.clear();
 
   if (!accept(Symbol::LeftBracket))
     throw(ParseError(
-        "Transformation List: Expected a left bracket. Found: " + symbol.text,
+        "Transformation List: Expected a left bracket. Found: " + symbol.getText(),
         symbol.pos));
 
   while (symbol.type == Symbol::Operator)
@@ -428,7 +443,7 @@ auto EisenParser::transformationList() -> Transformation
   if (!accept(Symbol::RightBracket))
     throw(ParseError(
         "Transformation List: Expected a right bracket or an operator. Found: "
-            + symbol.text,
+            + symbol.getText(),
         symbol.pos));
 
   return t;
@@ -441,65 +456,86 @@ auto EisenParser::action() -> Action
   //  rulename
   //  20 * { x 10 } 10 * { y 10 } rulename
 
+  // Records the last transformation list, if it depends on GUI parameters.
+  actionLoops.clear();
+  auto recordLoop = [&](int loop, int repetitions, int repetitionsSlot)
+  {
+    bool parametric = repetitionsSlot != -1;
+    for (const ParametricOperator& o : operators)
+    {
+      for (int slot : o.slots)
+        parametric |= slot != -1;
+    }
+    if (parametric)
+      actionLoops.push_back(
+          {nullptr, -1, loop, repetitions, repetitionsSlot, std::move(operators)});
+  };
+
   if (symbol.type == Symbol::LeftBracket)
   {
     Transformation t = transformationList();
-    QString ruleName = symbol.text.trimmed();
+    recordLoop(0, 1, -1);
+    QString ruleName = symbol.getText().trimmed();
     if (!accept(Symbol::UserString))
       throw(ParseError(
-          "Expected a rule name after the transformation list. Found: " + symbol.text,
+          "Expected a rule name after the transformation list. Found: "
+              + symbol.getText(),
           symbol.pos));
     return {t, ruleName};
   }
-  else if (symbol.type == Symbol::UserString)
-  {
-    QString ruleName = symbol.text.trimmed();
-    accept(Symbol::UserString);
-    return {ruleName};
-  }
-  else if (symbol.type == Symbol::Number)
+  else if (isLoopCount())
   {
     Action action;
 
-    while (symbol.type == Symbol::Number)
+    while (isLoopCount())
     {
       // number of loops...
-      if (!symbol.isInteger)
+      const Symbol countSymbol = symbol;
+      double count = 0;
+      int slot = -1;
+      acceptNumber(count, slot);
+      if (slot == -1 ? !countSymbol.isInteger
+                     : !dynamic_cast<IntParameter*>(parameters[slot]))
         throw(ParseError(
             "Expected an integer count in the transformation loop. Found: "
-                + symbol.text,
-            symbol.pos));
-      int count = symbol.intValue;
-      getSymbol();
+                + countSymbol.getText(),
+            countSymbol.pos));
 
       // '*'
       if (!accept(Symbol::Multiply))
         throw(ParseError(
-            "Expected a '*' after the transformation count. Found: " + symbol.text,
+            "Expected a '*' after the transformation count. Found: " + symbol.getText(),
             symbol.pos));
 
       // transformation list
       Transformation t = transformationList();
-      action.addTransformationLoop(TransformationLoop(count, t));
+      recordLoop(action.getLoops().size(), int(count), slot);
+      action.addTransformationLoop(TransformationLoop(int(count), t));
     }
 
     // Rule reference
-    QString ruleName = symbol.text.trimmed();
+    QString ruleName = symbol.getText().trimmed();
     if (!accept(Symbol::UserString))
       throw(ParseError(
           "Expected a rule name or a new loop after the transformation list. Found: "
-              + symbol.text,
+              + symbol.getText(),
           symbol.pos));
     action.setRule(ruleName);
 
     return action;
   }
+  else if (symbol.type == Symbol::UserString)
+  {
+    QString ruleName = symbol.getText().trimmed();
+    accept(Symbol::UserString);
+    return {ruleName};
+  }
   else
   {
     throw(ParseError(
         "A rule action must start with either a number, a rule name or a left bracket. "
         "Found: "
-            + symbol.text,
+            + symbol.getText(),
         symbol.pos));
   }
 }
@@ -508,15 +544,15 @@ auto EisenParser::setAction() -> Action
 {
   accept(Symbol::Set);
 
-  QString key = symbol.text;
-  if (symbol.type == Symbol::Operator && key == "maxdepth")
+  QString key = symbol.getText();
+  if (symbol.op == Symbol::MaxDepth)
   {
     getSymbol();
   }
   else if (!accept(Symbol::UserString))
-    throw(
-        ParseError("Expected a valid setting name. Found: " + symbol.text, symbol.pos));
-  QString value = symbol.text;
+    throw(ParseError(
+        "Expected a valid setting name. Found: " + symbol.getText(), symbol.pos));
+  QString value = symbol.getText();
   getSymbol(); // We will accept everything here!
 
   if (key == "recursion" && value == "depth")
@@ -542,12 +578,12 @@ auto EisenParser::ruleset() -> RuleSet*
     else if (symbol.type == Symbol::Set)
     {
       Action a = setAction();
-      rs->getTopLevelRule()->appendAction(a);
+      appendAction(rs->getTopLevelRule(), a);
     }
     else
     {
       Action a = action();
-      rs->getTopLevelRule()->appendAction(a);
+      appendAction(rs->getTopLevelRule(), a);
     }
   }
 
@@ -555,7 +591,7 @@ auto EisenParser::ruleset() -> RuleSet*
     throw(ParseError(
         "Unexpected symbol found. At this scope only RULE and SET statements are "
         "allowed. Found: "
-            + symbol.text,
+            + symbol.getText(),
         symbol.pos));
   if (recurseDepth)
     rs->setRecurseDepthFirst(true);
@@ -5,13 +5,42 @@
 #include <ssynth/Model/Rule.h>
 #include <ssynth/Model/RuleSet.h>
 #include <ssynth/Model/Transformation.h>
+#include <ssynth/Parser/Preprocessor.h>
 #include <ssynth/Parser/Tokenizer.h>
 
+#include <QHash> // std::hash<QString>
+
+#include <unordered_map>
+#include <vector>
+
 namespace ssynth
 {
 namespace Parser
 {
 
+/// A transformation operator (e.g. 'rx angle'), as parsed.
+struct ParametricOperator
+{
+  Symbol::OperatorType op;
+  std::vector<double> arguments;
+  /// The index of the GUI parameter used for each argument (or -1 for a number).
+  std::vector<int> slots;
+  /// The color argument of 'color' and 'blend'.
+  QString color;
+};
+
+/// A transformation loop depending on GUI parameters: its transformation is the
+/// product of 'operators', repeated 'repetitions' times.
+struct ParametricLoop
+{
+  Model::CustomRule* rule;
+  int action; // The index of the action in the rule.
+  int loop;   // The index of the loop in the action.
+  int repetitions;
+  int repetitionsSlot; // The GUI parameter used as the count (or -1).
+  std::vector<ParametricOperator> operators;
+};
+
 /// The' Eisenstein Engine' is a simple recursive descent parser,
 /// for parsing 'EisenScript'.
 class EisenParser
@@ -29,6 +58,22 @@ public:
   Model::RuleSet* parseRuleset();
   bool recurseDepthFirst() { return recurseDepth; }
 
+  /// Accepts the names of the GUI parameters (see 'Preprocessor') as the arguments of
+  /// the transformations, and the names of the integer parameters as loop counts.
+  /// They take their default values: the loops using them are listed by
+  /// 'getParametricLoops', so they can be rebuilt for other values.
+  void setParameters(const std::vector<GuiParameter*>& parameters);
+  const std::vector<ParametricLoop>& getParametricLoops() const
+  {
+    return parametricLoops;
+  }
+
+  /// Creates the transformation of an operator, from its parsed arguments.
+  static Model::Transformation createTransformation(
+      Symbol::OperatorType op,
+      const std::vector<double>& arguments,
+      const QString& color);
+
 private:
   bool recurseDepth;
   void getSymbol();
@@ -40,10 +85,26 @@ private:
   Model::Transformation transformation();
   void ruleModifierList(Model::CustomRule* customRule);
 
+  void appendAction(Model::CustomRule* customRule, const Model::Action& action);
+
   bool accept(Symbol::SymbolType st);
   bool expect(Symbol::SymbolType st);
+  /// True if the symbol is a number or the name of a GUI parameter.
+  bool isNumber() const;
+  /// True if the symbol is the count of a transformation loop.
+  bool isLoopCount();
+  /// Accepts a number or a GUI parameter, and returns its value and its slot (or -1).
+  bool acceptNumber(double& value, int& slot);
   Symbol symbol;
 
+  std::vector<GuiParameter*> parameters;
+  std::unordered_map<QString, int> parameterSlots; // By lowercase name.
+  // The operators of the transformation list being parsed.
+  std::vector<ParametricOperator> operators;
+  // The parametric loops of the action being parsed (not yet in a rule).
+  std::vector<ParametricLoop> actionLoops;
+  std::vector<ParametricLoop> parametricLoops;
+
   Tokenizer& tokenizer;
 };
 
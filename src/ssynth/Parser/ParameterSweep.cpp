@@ -0,0 +1,153 @@
+#include <ssynth/Exception.h>
+#include <ssynth/Model/RuleSetCache.h>
+#include <ssynth/Parser/ParameterSweep.h>
+#include <ssynth/Parser/Tokenizer.h>
+#include <ssynth/ThreadPool.h>
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace ssynth
+{
+using namespace Exceptions;
+using namespace Model;
+
+namespace Parser
+{
+
+ParameterSweep::ParameterSweep(const QString& script, int seed)
+{
+  Preprocessor preprocessor;
+  const QString preprocessed = preprocessor.Process(script, seed);
+  parameters = preprocessor.getParameters();
+  for (GuiParameter* parameter : parameters)
+  {
+    ownedParameters.emplace_back(parameter);
+    if (auto* fp = dynamic_cast<FloatParameter*>(parameter))
+    {
+      defaultValues.push_back(fp->getDefaultValue());
+      integer.push_back(false);
+    }
+    else
+    {
+      defaultValues.push_back(static_cast<IntParameter*>(parameter)->getDefaultValue());
+      integer.push_back(true);
+    }
+  }
+
+  Tokenizer tokenizer{preprocessed};
+  EisenParser parser{tokenizer};
+  parser.setParameters(parameters);
+  std::unique_ptr<RuleSet> ruleSet(parser.parseRuleset());
+  ruleSet->resolveNames();
+
+  const QByteArray serialized = RuleSetCache::serialize(*ruleSet, {});
+  size = serialized.size();
+  data.reset(new char[size]);
+  memcpy(data.get(), serialized.constData(), size);
+
+  std::unordered_map<const CustomRule*, int> ruleIndices;
+  const std::vector<CustomRule*> rules = ruleSet->getCustomRules();
+  for (int i = 0; i < rules.size(); i++)
+    ruleIndices[rules[i]] = i;
+  for (const ParametricLoop& loop : parser.getParametricLoops())
+  {
+    loopRules.push_back(ruleIndices.at(loop.rule));
+    loops.push_back(loop);
+    loops.back().rule = nullptr; // Only valid for 'ruleSet'.
+  }
+}
+
+ParameterSweep::~ParameterSweep() = default;
+
+auto ParameterSweep::indexOf(const QString& name) const -> int
+{
+  // As the parser, the last definition wins.
+  for (int i = parameters.size() - 1; i >= 0; i--)
+  {
+    if (parameters[i]->getName().toLower() == name.toLower())
+      return i;
+  }
+  return -1;
+}
+
+auto ParameterSweep::instantiate(const std::vector<double>& values) const -> RuleSet*
+{
+  if (values.size() != parameters.size())
+    throw Exception(QString("Expected %1 parameter values, got %2.")
+                        .arg(parameters.size())
+                        .arg(values.size()));
+  std::vector<double> v = values;
+  for (int i = 0; i < v.size(); i++)
+  {
+    if (integer[i])
+      v[i] = std::round(v[i]);
+  }
+
+  std::unique_ptr<RuleSet> ruleSet(RuleSetCache::deserialize(data.get(), size, {}));
+  if (!ruleSet)
+    throw Exception("ParameterSweep: could not copy the RuleSet.");
+
+  const std::vector<CustomRule*> rules = ruleSet->getCustomRules();
+  std::vector<double> arguments;
+  for (int i = 0; i < loops.size(); i++)
+  {
+    const ParametricLoop& loop = loops[i];
+    Transformation t;
+    for (const ParametricOperator& o : loop.operators)
+    {
+      arguments = o.arguments;
+      for (int j = 0; j < arguments.size(); j++)
+      {
+        if (o.slots[j] != -1)
+          arguments[j] = v[o.slots[j]];
+      }
+      t.append(EisenParser::createTransformation(o.op, arguments, o.color));
+    }
+    int repetitions = loop.repetitions;
+    if (loop.repetitionsSlot != -1)
+    {
+      // The loop counts must stay in the range of their parameter.
+      auto* parameter = static_cast<IntParameter*>(parameters[loop.repetitionsSlot]);
+      const double value = v[loop.repetitionsSlot];
+      if (!(value >= parameter->getFrom() && value <= parameter->getTo()))
+        throw Exception(
+            QString("The loop count '%1' must be in [%2;%3]. Found: %4")
+                .arg(parameter->getName())
+                .arg(parameter->getFrom())
+                .arg(parameter->getTo())
+                .arg(value));
+      repetitions = int(value);
+    }
+    rules[loopRules[i]]->getActions()[loop.action].getLoops()[loop.loop]
+        = TransformationLoop(repetitions, t);
+  }
+  return ruleSet.release();
+}
+
+void ParameterSweep::run(
+    const std::vector<std::vector<double>>& values,
+    int threads,
+    const std::function<void(int, RuleSet&)>& job) const
+{
+  Misc::ThreadPool pool(threads);
+  pool.run(
+      values.size(),
+      [&](int i)
+      {
+        std::unique_ptr<RuleSet> ruleSet;
+        try
+        {
+          ruleSet.reset(instantiate(values[i]));
+        }
+        catch (Exception& e)
+        {
+          throw Exception(QString("Frame %1: %2").arg(i).arg(e.getMessage()));
+        }
+        job(i, *ruleSet);
+      });
+}
+
+}
+}
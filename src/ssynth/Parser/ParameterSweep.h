@@ -0,0 +1,72 @@
+#pragma once
+
+#include <ssynth/Model/RuleSet.h>
+#include <ssynth/Parser/EisenParser.h>
+#include <ssynth/Parser/Preprocessor.h>
+
+#include <QString>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ssynth
+{
+namespace Parser
+{
+
+/// Builds the RuleSets of a script for many values of its GUI parameters
+/// (e.g. '#define angle 10 (float:0-90)', see 'Preprocessor'), such as the frames of
+/// an animation.
+///
+/// The script is preprocessed, parsed and resolved once. Every parameter vector gets a
+/// copy of the resolved RuleSet (made with the 'RuleSetCache' format), where only the
+/// transformation loops using the parameters are rebuilt.
+///
+/// The parameters can be used as the arguments of the transformations, and the integer
+/// parameters as loop counts (see 'EisenParser::setParameters').
+class ParameterSweep
+{
+public:
+  /// Parses 'script', and throws a ParseError if it is invalid.
+  /// 'seed' is used for the 'random[a,b]' statements, which are expanded once.
+  explicit ParameterSweep(const QString& script, int seed = 0);
+  ~ParameterSweep();
+
+  const std::vector<GuiParameter*>& getParameters() const { return parameters; }
+  const std::vector<double>& getDefaultValues() const { return defaultValues; }
+
+  /// Returns the index of the parameter named 'name' (case insensitive), or -1.
+  int indexOf(const QString& name) const;
+
+  /// Returns the RuleSet for the parameter 'values', in the order of 'getParameters'
+  /// (owned by the caller). The values of the integer parameters are rounded.
+  /// Throws an Exception if a loop count is outside the range of its parameter.
+  Model::RuleSet* instantiate(const std::vector<double>& values) const;
+
+  /// Calls 'job(i, ruleSet)' with the RuleSet of 'values[i]', for every i, on 'threads'
+  /// threads (see 'Misc::ThreadPool::run'). The RuleSets are deleted after the calls.
+  /// The errors of 'instantiate' are reported with the index of the frame.
+  void run(
+      const std::vector<std::vector<double>>& values,
+      int threads,
+      const std::function<void(int, Model::RuleSet&)>& job) const;
+
+private:
+  std::vector<std::unique_ptr<GuiParameter>> ownedParameters;
+  std::vector<GuiParameter*> parameters;
+  std::vector<double> defaultValues;
+  std::vector<bool> integer; // By parameter.
+
+  // The resolved RuleSet, serialized (aligned for 'RuleSetCache::deserialize').
+  std::unique_ptr<char[]> data;
+  std::size_t size{};
+
+  // The loops to rebuild, and the index of their rule in 'RuleSet::getCustomRules'.
+  std::vector<ParametricLoop> loops;
+  std::vector<int> loopRules;
+};
+
+}
+}
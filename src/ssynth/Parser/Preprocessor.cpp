@@ -2,10 +2,9 @@
 #include <ssynth/Parser/Preprocessor.h>
 
 #include <QRandomGenerator>
-#include <QRegularExpression>
 #include <QStringList>
 
-#include <map>
+#include <utility>
 namespace ssynth
 {
 using namespace Exceptions;
@@ -13,169 +12,372 @@ using namespace Logging;
 namespace Parser
 {
 
-auto Preprocessor::Process(const QString& input, int seed) -> QString
+namespace
 {
-  QRandomGenerator rg(seed);
+// The '#define'd names and their values, in a trie of the names (so the names are
+// found while the text is scanned, whatever their number).
+class DefineTrie
+{
+public:
+  void insert(const QString& name, const QString& value)
+  {
+    int node = 0;
+    for (QChar c : name)
+    {
+      int child = findChild(node, c.unicode());
+      if (child == -1)
+      {
+        child = nodes.size();
+        nodes[node].children.emplace_back(c.unicode(), child);
+        nodes.emplace_back();
+      }
+      node = child;
+    }
+    if (nodes[node].value == -1)
+    {
+      nodes[node].value = values.size();
+      names.push_back(name);
+      values.push_back(value);
+    }
+    else
+    {
+      values[nodes[node].value] = value;
+    }
+  }
 
-  QStringList in = input.split(QRegularExpression("\r\n|\r|\n"));
+  /// Returns the index of the first name (in the order of the names) found in 'text',
+  /// or -1 if there is none.
+  int findFirst(const QString& text) const
+  {
+    const QChar* data = text.constData();
+    const int size = text.size();
+    int first = -1;
+    for (int pos = 0; pos < size; pos++)
+    {
+      int node = 0;
+      for (int i = pos; i < size; i++)
+      {
+        node = findChild(node, data[i].unicode());
+        if (node == -1)
+          break;
+        const int value = nodes[node].value;
+        if (value != -1 && value != first
+            && (first == -1 || names[value] < names[first]))
+          first = value;
+      }
+    }
+    return first;
+  }
 
-  std::map<QString, QString> substitutions;
+  const QString& name(int index) const { return names[index]; }
+  const QString& value(int index) const { return values[index]; }
+  bool isEmpty() const { return values.empty(); }
 
-  QRegularExpression defineCommand(
-      R"(^#define\s([^\s]+)\s(.*)*$)"); // Look for #define varname value
-  QRegularExpression defineFloatCommand(
-      R"(^#define\s([^\s]+)\s(.*)\s\(float:([^\s]*)\)$)"); // Look for #define varname value
-  QRegularExpression defineIntCommand(
-      R"(^#define\s([^\s]+)\s(.*)\s\(int:([^\s]*)\)$)"); // Look for #define varname value
+private:
+  int findChild(int node, char16_t c) const
+  {
+    for (const auto& [key, child] : nodes[node].children)
+    {
+      if (key == c)
+        return child;
+    }
+    return -1;
+  }
 
-  // Match a number: [-+]?[0-9]*\.?[0-9]+
-  QRegularExpression randomNumber(
-      R"(random\[([-+]?[0-9]*\.?[0-9]+),([-+]?[0-9]*\.?[0-9]+)\])"); // random[-2.3,3.4]
+  struct Node
+  {
+    std::vector<std::pair<char16_t, int>> children;
+    int value{-1};
+  };
+  std::vector<Node> nodes{1};
+  std::vector<QString> names;
+  std::vector<QString> values;
+};
 
-  for (QString& it : in)
+// Replaces the defined names in 'line'. As before, the first name found (in the order
+// of the names) is replaced everywhere in the line, and the search starts over: the
+// names overlapping others, or formed by a replacement, are expanded as they used to be.
+// At most 101 replacements are made (and 'tooMany' is set after them).
+void substitute(QString& line, const DefineTrie& defines, bool& tooMany)
+{
+  for (int count = 0;; count++)
   {
-    if (it.startsWith("#"))
+    if (count > 100)
     {
-      // Preprocessor command
-      const auto defineMatches = defineCommand.match(it);
-      const auto defineFloatMatches = defineFloatCommand.match(it);
-      const auto defineIntMatches = defineIntCommand.match(it);
+      tooMany = true;
+      return;
+    }
+    const int define = defines.findFirst(line);
+    if (define == -1)
+      return;
+    line.replace(defines.name(define), defines.value(define));
+  }
+}
+
+// Parses '#define name value' (exactly one space character before and after the name).
+bool parseDefine(const QString& line, QString& name, QString& value)
+{
+  static const QString command = "#define";
+  const int size = line.size();
+  int begin = command.size() + 1;
+  if (!line.startsWith(command) || size < begin || !line.at(begin - 1).isSpace())
+    return false;
+  int end = begin;
+  while (end < size && !line.at(end).isSpace())
+    end++;
+  if (end == begin || end == size)
+    return false;
+  name = line.mid(begin, end - begin);
+  value = line.mid(end + 1);
+  return true;
+}
+
+// Splits the value of a GUI parameter definition: 'defaultValue (type:interval)'.
+bool parseGuiParameter(
+    const QString& value,
+    const QString& type,
+    QString& defaultValue,
+    QString& interval)
+{
+  const QString marker = "(" + type + ":";
+  const int start = value.lastIndexOf(marker);
+  if (start < 1 || !value.at(start - 1).isSpace() || !value.endsWith(")"))
+    return false;
+  interval = value.mid(start + marker.size(), value.size() - 1 - start - marker.size());
+  for (QChar c : interval)
+  {
+    if (c.isSpace())
+      return false;
+  }
+  defaultValue = value.left(start - 1);
+  return true;
+}
+
+void warnIfRecursive(const QString& name, const QString& value)
+{
+  if (value.contains(name))
+  {
+    WARNING(QString("#define command is recursive - skipped: %1 -> %2")
+                .arg(name)
+                .arg(value));
+  }
+}
+
+// The 'add...Parameter' functions return false if the definition is invalid.
+bool addFloatParameter(
+    const QString& name,
+    const QString& defaultValue,
+    const QString& interval,
+    std::vector<GuiParameter*>& params)
+{
+  warnIfRecursive(name, defaultValue);
+  QStringList fi = interval.split("-");
+  if (fi.size() != 2)
+  {
+    WARNING("Could not understand #define gui command: " + interval);
+    return false;
+  }
+  bool succes = false;
+  double d1 = fi[0].toDouble(&succes);
+  bool succes2 = false;
+  double d2 = fi[1].toDouble(&succes2);
+  if (!succes || !succes2)
+  {
+    WARNING("Could not parse float interval in #define gui command: " + interval);
+    return false;
+  }
+  bool succes3 = false;
+  double d3 = defaultValue.toDouble(&succes3);
+  if (!succes3)
+  {
+    WARNING("Could not parse default argument in #define gui command: " + defaultValue);
+    return false;
+  }
+  params.push_back(new FloatParameter(name, d1, d2, d3));
+  return true;
+}
 
-      if (defineFloatMatches.hasMatch())
+bool addIntParameter(
+    const QString& name,
+    const QString& defaultValue,
+    const QString& interval,
+    std::vector<GuiParameter*>& params)
+{
+  warnIfRecursive(name, defaultValue);
+  QStringList ii = interval.split("-");
+  if (ii.size() != 2)
+  {
+    WARNING("Could not understand #define gui command: " + interval);
+    return false;
+  }
+  bool succes = false;
+  int i1 = ii[0].toInt(&succes);
+  bool succes2 = false;
+  int i2 = ii[1].toInt(&succes2);
+  if (!succes || !succes2)
+  {
+    WARNING("Could not parse int interval in #define gui command: " + interval);
+    return false;
+  }
+  bool succes3 = false;
+  int i3 = defaultValue.toInt(&succes3);
+  if (!succes3)
+  {
+    WARNING("Could not parse default argument in #define gui command: " + defaultValue);
+    return false;
+  }
+  params.push_back(new IntParameter(name, i1, i2, i3));
+  return true;
+}
+
+// Matches a number at 'text[pos]' ([-+]?[0-9]*\.?[0-9]+) and returns its end (or -1).
+int matchNumber(const QChar* text, int size, int pos)
+{
+  auto isDigit = [](QChar c) { return c.unicode() >= '0' && c.unicode() <= '9'; };
+  if (pos < size && (text[pos] == '+' || text[pos] == '-'))
+    pos++;
+  const int digitsStart = pos;
+  while (pos < size && isDigit(text[pos]))
+    pos++;
+  if (pos < size && text[pos] == '.')
+  {
+    const int fractionStart = ++pos;
+    while (pos < size && isDigit(text[pos]))
+      pos++;
+    return pos > fractionStart ? pos : -1;
+  }
+  return pos > digitsStart ? pos : -1;
+}
+
+// Appends 'line' to 'out' with its 'random[a,b]' replaced by random numbers.
+// As before, every occurrence draws a number, but identical occurrences on the same
+// line are all replaced by the value of the first one.
+void expandRandom(const QString& line, QRandomGenerator& rg, QString& out)
+{
+  static const QString random = "random[";
+  const QChar* text = line.constData();
+  const int size = line.size();
+  std::vector<std::pair<QString, QString>> expanded; // On this line
+
+  int copied = 0;
+  for (int i = line.indexOf(random); i != -1; i = line.indexOf(random, i))
+  {
+    const int first = i + random.size();
+    const int firstEnd = matchNumber(text, size, first);
+    const int second = firstEnd + 1;
+    const int secondEnd = firstEnd == -1 || firstEnd >= size || text[firstEnd] != ','
+                              ? -1
+                              : matchNumber(text, size, second);
+    if (secondEnd == -1 || secondEnd >= size || text[secondEnd] != ']')
+    {
+      i++;
+      continue;
+    }
+
+    const QString match = line.mid(i, secondEnd + 1 - i);
+    double d1 = line.mid(first, firstEnd - first).toDouble();
+    double d2 = line.mid(second, secondEnd - second).toDouble();
+    double r = rg.generateDouble() * (d2 - d1) + d1;
+    INFO(QString("Random number: %1 -> %2 ").arg(match).arg(r));
+
+    QString number = QString::number(r);
+    for (const auto& [text, value] : expanded)
+    {
+      if (text == match)
       {
-        //INFO(QString("Found ppC (%1)->(%2): ").arg(defineCommandWithGUI.cap(1)).arg(defineCommandWithGUI.cap(2)) + *it);
-        if (defineFloatMatches.captured(2).contains(defineFloatMatches.captured(1)))
-        {
-          WARNING(QString("#define command is recursive - skipped: %1 -> %2")
-                      .arg(defineFloatMatches.captured(1))
-                      .arg(defineFloatMatches.captured(2)));
-        }
-        //substitutions[defineCommandWithGUI.cap(1)] = defineCommandWithGUI.cap(2);
-        QString defaultValue = defineFloatMatches.captured(2);
-        QString floatInterval = defineFloatMatches.captured(3);
-        QStringList fi = floatInterval.split("-");
-        if (fi.size() != 2)
-        {
-          WARNING("Could not understand #define gui command: " + floatInterval);
-          continue;
-        }
-        bool succes = false;
-        double d1 = fi[0].toDouble(&succes);
-        bool succes2 = false;
-        double d2 = fi[1].toDouble(&succes2);
-        if (!succes || !succes2)
-        {
-          WARNING(
-              "Could not parse float interval in #define gui command: " + floatInterval);
-          continue;
-        }
-        bool succes3 = false;
-        double d3 = defineFloatMatches.captured(2).toDouble(&succes3);
-        if (!succes3)
-        {
-          WARNING(
-              "Could not parse default argument in #define gui command: "
-              + defineFloatMatches.captured(2));
-          continue;
-        }
-        auto* fp = new FloatParameter(defineFloatMatches.captured(1), d1, d2, d3);
-        params.push_back(fp);
+        number = value;
+        break;
       }
-      else if (defineIntMatches.hasMatch())
+    }
+    expanded.emplace_back(match, number);
+
+    out.append(text + copied, i - copied);
+    out.append(number);
+    i = secondEnd + 1;
+    copied = i;
+  }
+  out.append(text + copied, size - copied);
+}
+}
+
+auto Preprocessor::Process(const QString& input, int seed) -> QString
+{
+  QRandomGenerator rg(seed);
+
+  DefineTrie substitutions;
+  QString out;
+  out.reserve(input.size() + input.size() / 8);
+  QString it;
+  QString name;
+  QString value;
+  QString defaultValue;
+  QString interval;
+  bool tooMany = false;
+
+  const QChar* text = input.constData();
+  const int size = input.size();
+  for (int lineStart = 0; lineStart <= size;)
+  {
+    // Lines end with "\r\n", "\r" or "\n".
+    int lineEnd = lineStart;
+    while (lineEnd < size && text[lineEnd] != '\r' && text[lineEnd] != '\n')
+      lineEnd++;
+
+    it.clear();
+    bool expandLine = true;
+    if (lineEnd > lineStart && text[lineStart] == '#')
+    {
+      // Preprocessor command
+      it.append(text + lineStart, lineEnd - lineStart);
+      if (!parseDefine(it, name, value))
+      {
+        WARNING("Could not understand preprocessor command: " + it);
+      }
+      else if (parseGuiParameter(value, "float", defaultValue, interval))
       {
-        INFO("INT");
-        if (defineIntMatches.captured(2).contains(defineIntMatches.captured(1)))
-        {
-          WARNING(QString("#define command is recursive - skipped: %1 -> %2")
-                      .arg(defineIntMatches.captured(1))
-                      .arg(defineIntMatches.captured(2)));
-        }
-        QString defaultValue = defineIntMatches.captured(2);
-        QString intInterval = defineIntMatches.captured(3);
-        QStringList ii = intInterval.split("-");
-        if (ii.size() != 2)
-        {
-          WARNING("Could not understand #define gui command: " + intInterval);
-          continue;
-        }
-        bool succes = false;
-        int i1 = ii[0].toInt(&succes);
-        bool succes2 = false;
-        int i2 = ii[1].toInt(&succes2);
-        if (!succes || !succes2)
-        {
-          WARNING("Could not parse int interval in #define gui command: " + intInterval);
-          continue;
-        }
-        bool succes3 = false;
-        int i3 = defineIntMatches.captured(2).toInt(&succes3);
-        if (!succes3)
-        {
-          WARNING(
-              "Could not parse default argument in #define gui command: "
-              + defineIntMatches.captured(2));
-          continue;
-        }
-        auto* fp = new IntParameter(defineIntMatches.captured(1), i1, i2, i3);
-        params.push_back(fp);
+        expandLine = addFloatParameter(name, defaultValue, interval, params);
       }
-      else if (defineMatches.hasMatch())
+      else if (parseGuiParameter(value, "int", defaultValue, interval))
       {
-        if (defineMatches.captured(2).contains(defineMatches.captured(1)))
-        {
-          WARNING(QString("#define command is recursive - skipped: %1 -> %2")
-                      .arg(defineMatches.captured(1))
-                      .arg(defineMatches.captured(2)));
-        }
-        substitutions[defineMatches.captured(1)] = defineMatches.captured(2);
+        expandLine = addIntParameter(name, defaultValue, interval, params);
+      }
+      else if (value.contains(name))
+      {
+        warnIfRecursive(name, value);
       }
       else
       {
-        WARNING("Could not understand preprocessor command: " + it);
+        substitutions.insert(name, value);
       }
     }
-    else
+    else if (substitutions.isEmpty())
     {
-      // Non-preprocessor command
-      // Check for substitutions.
-      auto it2 = substitutions.cbegin();
-      int subst = 0;
-      while (it2 != substitutions.cend())
-      {
-        if (subst > 100)
-        {
-          WARNING("More than 100 recursive preprocessor substitutions... breaking.");
-          break;
-        }
-        if (it.contains(it2->first))
-        {
-          //INFO("Replacing: " + it2.key() + " with " + it2.value());
-          it.replace(it2->first, it2->second);
-
-          it2 = substitutions.cbegin();
-          subst++;
-        }
-        else
-        {
-          it2++;
-        }
-      }
+      it.append(text + lineStart, lineEnd - lineStart);
     }
-
-    auto randNumMatches = randomNumber.globalMatch(it);
-    while (randNumMatches.hasNext())
+    else
     {
-      auto randNumMatch = randNumMatches.next();
-      double d1 = randNumMatch.captured(1).toDouble();
-      double d2 = randNumMatch.captured(2).toDouble();
-      double r = rg.generateDouble() * (d2 - d1) + d1;
-      INFO(QString("Random number: %1 -> %2 ").arg(randomNumber.cap(0)).arg(r));
-      it.replace(randNumMatch.captured(0), QString::number(r));
+      // Non-preprocessor command: substitute the defined names.
+      it.append(text + lineStart, lineEnd - lineStart);
+      substitute(it, substitutions, tooMany);
     }
+
+    if (lineStart > 0)
+      out.append("\r\n");
+    // As before, the invalid GUI parameter definitions are not expanded.
+    if (expandLine)
+      expandRandom(it, rg, out);
+    else
+      out.append(it);
+
+    if (lineEnd < size - 1 && text[lineEnd] == '\r' && text[lineEnd + 1] == '\n')
+      lineEnd++;
+    lineStart = lineEnd + 1;
   }
 
-  QStringList out = in;
-  return out.join("\r\n");
+  if (tooMany)
+    WARNING("More than 100 recursive preprocessor substitutions... breaking.");
+
+  return out;
 }
 }
 }
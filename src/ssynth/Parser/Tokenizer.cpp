@@ -1,275 +1,318 @@
 #include <ssynth/Parser/Tokenizer.h>
 
-#include <QRegularExpression>
-#include <QStringList>
+#include <array>
+#include <charconv>
+#include <cstdint>
+
 namespace ssynth::Parser
 {
 
+namespace
+{
+struct OperatorName
+{
+  std::string_view name;
+  Symbol::OperatorType op;
+};
+
+constexpr OperatorName operatorNames[] = {
+    {"c", Symbol::Color},       {"reflect", Symbol::Reflect},
+    {"color", Symbol::Color},   {"blend", Symbol::Blend},
+    {"a", Symbol::Alpha},       {"alpha", Symbol::Alpha},
+    {"matrix", Symbol::Matrix}, {"h", Symbol::Hue},
+    {"hue", Symbol::Hue},       {"sat", Symbol::Sat},
+    {"b", Symbol::Brightness},  {"brightness", Symbol::Brightness},
+    {"v", Symbol::V},           {"x", Symbol::X},
+    {"y", Symbol::Y},           {"z", Symbol::Z},
+    {"rx", Symbol::RX},         {"ry", Symbol::RY},
+    {"rz", Symbol::RZ},         {"s", Symbol::S},
+    {"fx", Symbol::FX},         {"fy", Symbol::FY},
+    {"fz", Symbol::FZ},         {"maxdepth", Symbol::MaxDepth},
+    {"weight", Symbol::Weight}, {"md", Symbol::MaxDepth},
+    {"w", Symbol::Weight}};
+
+// Indexed by Symbol::OperatorType.
+constexpr const char* operatorLongNames[] = {
+    "",  "reflect", "color", "blend", "alpha", "matrix", "hue", "sat", "brightness",
+    "v", "x",       "y",     "z",     "rx",    "ry",     "rz",  "s",   "fx",
+    "fy", "fz",     "maxdepth", "weight"};
+static_assert(std::size(operatorLongNames) == Symbol::Weight + 1);
+
+constexpr unsigned char toLowerAscii(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : (unsigned char)c;
+}
+
+bool equalsLowerAscii(std::string_view s, std::string_view lower)
+{
+  if (s.size() != lower.size())
+    return false;
+  for (std::size_t i = 0; i < s.size(); i++)
+  {
+    if (toLowerAscii(s[i]) != (unsigned char)lower[i])
+      return false;
+  }
+  return true;
+}
+
+// A perfect hash of the operator names (checked below), from their length and their
+// first and last characters.
+constexpr std::size_t operatorHashSize = 64;
+constexpr std::size_t operatorHash(std::string_view s)
+{
+  return (s.size() * 5 + toLowerAscii(s.front()) * 46 + toLowerAscii(s.back()))
+         & (operatorHashSize - 1);
+}
+
+constexpr auto operatorTable = []
+{
+  std::array<int8_t, operatorHashSize> table{};
+  table.fill(-1);
+  for (std::size_t i = 0; i < std::size(operatorNames); i++)
+    table[operatorHash(operatorNames[i].name)] = i;
+  return table;
+}();
+
+constexpr bool operatorHashIsPerfect = []
+{
+  std::array<bool, operatorHashSize> used{};
+  for (const OperatorName& o : operatorNames)
+  {
+    if (used[operatorHash(o.name)])
+      return false;
+    used[operatorHash(o.name)] = true;
+  }
+  return true;
+}();
+static_assert(operatorHashIsPerfect, "Operator names collide in 'operatorHash'");
+
+auto findOperator(std::string_view s) -> Symbol::OperatorType
+{
+  const int i = operatorTable[operatorHash(s)];
+  if (i >= 0 && equalsLowerAscii(s, operatorNames[i].name))
+    return operatorNames[i].op;
+  return Symbol::NoOperator;
+}
+
+// As QString::toInt and toDouble: a leading '+' is accepted, and the whole text must
+// be a number.
+template <typename T>
+bool parseNumber(std::string_view s, T& value)
+{
+  if (!s.empty() && s[0] == '+')
+  {
+    s.remove_prefix(1);
+    if (!s.empty() && (s[0] == '+' || s[0] == '-'))
+      return false;
+  }
+  const auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), value);
+  return error == std::errc() && end == s.data() + s.size();
+}
+
+bool isSeparator(char c)
+{
+  return c == ' ' || c == '{' || c == '}' || c == '\r' || c == '\n' || c == '\t'
+         || c == '\f' || c == '\v';
+}
+}
+
+auto Symbol::getText() const -> QString
+{
+  switch (type)
+  {
+    case End:
+      return "#END#";
+    case Operator:
+      return operatorLongNames[op];
+    case UserString:
+      return QString::fromUtf8(source.data(), source.size()).toLower();
+    default:
+      return QString::fromUtf8(source.data(), source.size());
+  }
+}
+
 Tokenizer::~Tokenizer() = default;
 
-Tokenizer::Tokenizer(QString input)
-    : currentSymbol(-1)
+Tokenizer::Tokenizer(const QString& input)
+    : utf8(input.toUtf8())
+    , input(utf8.constData(), utf8.size())
 {
+}
 
-  QStringList operators;
-  operators << "c"
-            << "reflect"
-            << "color"
-            << "blend"
-            << "a"
-            << "alpha"
-            << "matrix"
-            << "h"
-            << "hue"
-            << "sat"
-            << "b"
-            << "brightness"
-            << "v"
-            << "x"
-            << "y"
-            << "z"
-            << "rx"
-            << "ry"
-            << "rz"
-            << "s"
-            << "fx"
-            << "fy"
-            << "fz"
-            << "maxdepth"
-            << "weight"
-            << "md"
-            << "w";
-
-  // We will split on whitespace and line breaks
-  // TODO: Respect quotations ( file = "C:\Program Files\Test" )
-  QStringList l;
-  std::vector<int> positions;
-
-  // We will use our own split routine
-  QString current;
-  int startPos = 0;
-  input += " "; // to ensure last symbol gets parsed.
-  bool inMultiComment = false;
-  bool inComment = false;
-  int newlines = 0;
-  for (int i = 0; i < input.length(); i++)
+Tokenizer::Tokenizer(std::string_view input)
+    : input(input)
+{
+}
+
+auto Tokenizer::positionOf(std::size_t offset) -> int
+{
+  // Positions count UTF-16 characters (as QString indices), and ignore the '\r's.
+  for (; countedOffset < offset; countedOffset++)
   {
+    const unsigned char c = input[countedOffset];
+    if (c == '\r' || (c & 0xC0) == 0x80)
+      countedAdjustment++;
+    else if (c >= 0xF0)
+      countedAdjustment--; // A surrogate pair.
+  }
+  return int(offset) - countedAdjustment;
+}
 
-    if (input.at(i) == '\r')
-    {
+auto Tokenizer::peekSymbol() -> Symbol
+{
+  if (!peeked)
+    peeked = getSymbol();
+  return *peeked;
+}
+
+auto Tokenizer::getSymbol() -> Symbol
+{
+  if (peeked)
+  {
+    const Symbol s = *peeked;
+    peeked.reset();
+    return s;
+  }
+
+  const std::size_t size = input.size();
+  while (offset < size)
+  {
+    const char c = input[offset];
+
+    if (c == '\r' || c == '\n')
       inComment = false;
-      newlines++;
-    }
 
-    // Check if we found a preprocessor comment (there must occur at the beginning of a line.
-    if (input.at(i) == '#'
-        && ((i == 0) || (input.at(i - 1) == '\r') || (input.at(i - 1) == '\n')))
+    // Check if we found a preprocessor comment (there must occur at the beginning of a
+    // line).
+    if (c == '#'
+        && (offset == 0 || input[offset - 1] == '\r' || input[offset - 1] == '\n'))
     {
       inComment = true;
-      i++;
+      offset++;
       continue;
     }
 
-    if (i < input.length() - 1)
+    if (offset + 1 < size)
     {
-      if (input.at(i) == '*' && input.at(i + 1) == '/')
+      const char next = input[offset + 1];
+      if (c == '*' && next == '/')
       {
         inMultiComment = false;
-        i++;
+        offset += 2;
         continue;
       }
-
-      if (input.at(i) == '/' && input.at(i + 1) == '/')
-      {
-        inComment = true;
-        i++;
-        continue;
-      }
-
-      if (input.at(i) == '/' && input.at(i + 1) == '*')
+      if (c == '/' && (next == '/' || next == '*'))
       {
-        inMultiComment = true;
-        i++;
+        if (inMultiComment || inComment)
+        {
+          offset++;
+          continue;
+        }
+        if (next == '/')
+          inComment = true;
+        else
+          inMultiComment = true;
+        offset += 2;
         continue;
       }
     }
 
     if (inMultiComment || inComment)
+    {
+      offset++;
       continue;
+    }
 
-    if (input.at(i) == '[')
+    if (isSeparator(c))
     {
-      while (input.at(i) != ']' && i < input.length())
+      offset++;
+      if (c == '{' || c == '}')
       {
-        current += input.at(i);
-        i++;
+        return {
+            positionOf(offset - 1),
+            c == '{' ? Symbol::LeftBracket : Symbol::RightBracket,
+            input.substr(offset - 1, 1)};
       }
-      current += ']';
-
-      if (input.at(i) != ']')
-      {
-        throw ParseError("No matching ']' found for '['", startPos);
-      }
-
-      l.push_back(current);
-      positions.push_back(startPos - newlines);
-      startPos = i;
-      current = "";
+      continue;
     }
-    else if (
-        input.at(i) == '{' || input.at(i) == '}' || input.at(i) == ' '
-        || (input.at(i) == '\r') || (input.at(i) == '\n'))
+
+    // A symbol: it ends at a separator or a comment, or after a '[...]' block.
+    const std::size_t begin = offset;
+    while (offset < size && !isSeparator(input[offset]))
     {
-      QString trimmed = current.remove(QRegularExpression(R"(\s|\r|\n)"));
-      if (!current.trimmed().isEmpty())
+      const char d = input[offset];
+      if (d == '/' && offset + 1 < size
+          && (input[offset + 1] == '/' || input[offset + 1] == '*'))
+        break;
+      if (d == '[')
       {
-        l.push_back(trimmed);
-        positions.push_back(startPos - newlines);
+        const std::size_t close = input.find(']', offset);
+        if (close == std::string_view::npos)
+          throw ParseError("No matching ']' found for '['", positionOf(begin));
+        offset = close + 1;
+        break;
       }
-      if (input.at(i) == '{' || input.at(i) == '}')
-      {
-        l.push_back(QString(input.at(i)));
-        positions.push_back(i - newlines);
-      }
-      current = "";
-      startPos = i;
-    }
-    else
-    {
-      current += input.at(i);
+      offset++;
     }
+    return classify(begin, offset);
   }
 
-  for (int i = 0; i < l.size(); i++)
+  return {-1, Symbol::End, {}};
+}
+
+auto Tokenizer::classify(std::size_t begin, std::size_t end) -> Symbol
+{
+  const std::string_view s = input.substr(begin, end - begin);
+  const int pos = positionOf(begin);
+
+  if (equalsLowerAscii(s, "rule"))
+    return {pos, Symbol::Rule, s};
+  if (s == ">")
+    return {pos, Symbol::MoreThan, s};
+  if (s == "*")
+    return {pos, Symbol::Multiply, s};
+  if (equalsLowerAscii(s, "set"))
+    return {pos, Symbol::Set, s};
+
+  if (std::string_view("+-0123456789").find(s[0]) != std::string_view::npos)
   {
-    QString s = l[i];
-    int pos = positions[i];
-    QString sl = l[i].toLower();
+    // It is a number (hopefully)
+    Symbol ns(pos, Symbol::Number, s);
 
-    if (sl == "rule")
-    {
-      symbols.emplace_back(pos, Symbol::Rule, s);
-    }
-    else if (sl == "{")
-    {
-      symbols.emplace_back(pos, Symbol::LeftBracket, s);
-    }
-    else if (sl == ">")
+    const std::size_t slash = s.find('/');
+    if (slash != s.npos && s.find('/', slash + 1) == s.npos)
     {
-      symbols.emplace_back(pos, Symbol::MoreThan, s);
+      int i1 = 0;
+      int i2 = 0;
+      if (!parseNumber(s.substr(0, slash), i1) || !parseNumber(s.substr(slash + 1), i2)
+          || i1 == 0 || i2 == 0)
+        throw ParseError("Invalid fraction found: " + ns.getText(), pos);
+      ns.isInteger = false;
+      ns.floatValue = ((double)i1) / i2;
+      return ns;
     }
-    else if (sl == "}")
-    {
-      symbols.emplace_back(pos, Symbol::RightBracket, s);
-    }
-    else if (sl == "*")
-    {
-      symbols.emplace_back(pos, Symbol::Multiply, s);
-    }
-    else if (sl == "set")
-    {
-      symbols.emplace_back(pos, Symbol::Set, s);
-    }
-    else if (QString("+-0123456789").contains(s[0]))
-    {
-      // It is a number (hopefully)
 
-      if (s.count("/") == 1)
-      {
-        QString s1 = s.section("/", 0, 0);
-        QString s2 = s.section("/", 1, 1);
-        bool succes1 = false;
-        int i1 = s1.toInt(&succes1);
-        bool succes2 = false;
-        int i2 = s2.toInt(&succes2);
-
-        if ((i1 && i2) && (i2 != 0))
-        {
-          Symbol ns(pos, Symbol::Number, s);
-          ns.isInteger = false;
-          ns.floatValue = ((double)i1) / i2;
-          symbols.push_back(ns);
-          continue;
-        }
-        else
-        {
-          throw ParseError("Invalid fraction found: " + s, pos);
-        }
-      }
-
-      bool succes = false;
-      int i = s.toInt(&succes);
-
-      if (succes)
-      {
-        Symbol ns(pos, Symbol::Number, s);
-        ns.isInteger = true;
-        ns.intValue = i;
-        symbols.push_back(ns);
-        continue;
-      }
-
-      // the number was not an integer... Is it a floating-point value?
-
-      double d = s.toDouble(&succes);
-
-      if (succes)
-      {
-        Symbol ns(pos, Symbol::Number, s);
-        ns.isInteger = false;
-        ns.floatValue = d;
-        //INFO(QString("Added float value:%1").arg(ns.floatValue));
-        symbols.push_back(ns);
-        continue;
-      }
-
-      throw ParseError("Invalid symbol found: " + s, pos);
-    }
-    else if (operators.contains(sl))
-    {
-      QString longName = sl;
-
-      // Resolve abbreviations
-      if (longName == "md")
-        longName = "maxdepth";
-      if (longName == "w")
-        longName = "weight";
-      if (longName == "h")
-        longName = "hue";
-      if (longName == "b")
-        longName = "brightness";
-      if (longName == "a")
-        longName = "alpha";
-      if (longName == "c")
-        longName = "color";
-
-      Symbol ns(pos, Symbol::Operator, longName);
-      symbols.push_back(ns);
-    }
-    else
+    if (parseNumber(s, ns.intValue))
     {
-      // TODO: We should check syntax of userstring here... (we dont want strings like slk"{/})
-      Symbol ns(pos, Symbol::UserString, sl);
-      symbols.push_back(ns);
+      ns.isInteger = true;
+      return ns;
     }
-  }
 
-  for (int i = 0; i < symbols.size(); i++)
-  {
+    // the number was not an integer... Is it a floating-point value?
+    if (parseNumber(s, ns.floatValue))
+      return ns;
 
-    //INFO(QString("%1. Symbol: %2, Position: %3").arg(i).arg(symbols[i].text).arg(positions[i]));
+    throw ParseError("Invalid symbol found: " + ns.getText(), pos);
   }
-}
-
-auto Tokenizer::getSymbol() -> Symbol
-{
-  currentSymbol++;
 
-  if (currentSymbol < symbols.size())
+  if (Symbol::OperatorType op = findOperator(s); op != Symbol::NoOperator)
   {
-    return symbols[currentSymbol];
+    Symbol ns(pos, Symbol::Operator, s);
+    ns.op = op;
+    return ns;
   }
 
-  return {-1, Symbol::End, "#END#"};
+  // TODO: We should check syntax of userstring here... (we dont want strings like slk"{/})
+  return {pos, Symbol::UserString, s};
 }
 }
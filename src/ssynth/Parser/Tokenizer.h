@@ -2,9 +2,12 @@
 
 #include <ssynth/Exception.h>
 
+#include <QByteArray>
 #include <QString>
 
-#include <vector>
+#include <cstddef>
+#include <optional>
+#include <string_view>
 
 namespace ssynth
 {
@@ -40,28 +43,58 @@ struct Symbol
     Operator
   };
 
+  /// The operators (abbreviations are resolved: 'md' is a MaxDepth operator).
+  enum OperatorType
+  {
+    NoOperator,
+    Reflect,
+    Color,
+    Blend,
+    Alpha,
+    Matrix,
+    Hue,
+    Sat,
+    Brightness,
+    V,
+    X,
+    Y,
+    Z,
+    RX,
+    RY,
+    RZ,
+    S,
+    FX,
+    FY,
+    FZ,
+    MaxDepth,
+    Weight
+  };
+
   Symbol()
       : floatValue(0)
       , intValue(0)
       , isInteger(false)
       , pos(-1)
       , type(Undefined){};
-  Symbol(int pos, SymbolType s, QString original)
-      : text(original)
+  Symbol(int pos, SymbolType s, std::string_view source)
+      : source(source)
       , floatValue(0)
       , intValue(0)
       , isInteger(false)
       , pos(pos)
       , type(s){};
 
-  /// yes, yes, it is a bloated representation. (I don't like unions...)
-  QString
-      text; // The original text-string we parsed. Notice userstrings are converted to lower-case
+  /// Returns the text of the symbol: the long name of operators, the lower-case text
+  /// of user strings, and the original text of the other symbols.
+  QString getText() const;
+
+  std::string_view source; // The UTF-8 text parsed (points into the tokenizer input).
   double floatValue;
   int intValue;
   bool isInteger;
   int pos; // the position (char-index) of the original text parsed.
   SymbolType type;
+  OperatorType op{NoOperator};
 
   double getNumerical()
   {
@@ -73,22 +106,45 @@ struct Symbol
 
 /// The Tokenizer divides an input stream into distinct symbols,
 /// for subsequent parsing.
+///
+/// It works on a UTF-8 buffer, and only scans the next symbol when it is requested.
+/// The symbols refer to ranges of the buffer, which must outlive them.
 class Tokenizer
 {
 
 public:
-  /// Constructor.
-  Tokenizer(QString input);
+  /// Constructor (the input is converted to UTF-8).
+  explicit Tokenizer(const QString& input);
+  /// Constructor. 'input' is not copied, and must outlive the tokenizer.
+  explicit Tokenizer(std::string_view input);
 
   /// Destructor
   ~Tokenizer();
 
+  Tokenizer(const Tokenizer&) = delete;
+  Tokenizer& operator=(const Tokenizer&) = delete;
+
   /// Returns the next symbol
   Symbol getSymbol();
+  /// Returns the symbol following the last one returned by 'getSymbol' (which returns
+  /// it next).
+  Symbol peekSymbol();
 
 private:
-  std::vector<Symbol> symbols;
-  int currentSymbol;
+  Symbol classify(std::size_t begin, std::size_t end);
+  /// The symbol position of the byte 'offset' (which must not decrease between calls).
+  int positionOf(std::size_t offset);
+
+  QByteArray utf8; // Only used by the QString constructor.
+  std::string_view input;
+  std::size_t offset{0};
+  bool inComment{false};
+  bool inMultiComment{false};
+  std::optional<Symbol> peeked; // See 'peekSymbol'.
+
+  // See 'positionOf'.
+  std::size_t countedOffset{0};
+  int countedAdjustment{0};
 };
 
 }
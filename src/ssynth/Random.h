@@ -6,6 +6,7 @@
 #include <QString>
 #include <QStringList>
 
+#include <cstdint>
 #include <random>
 #include <vector>
 
@@ -43,7 +44,7 @@ public:
     return copy;
   }
 
-  // Returns a double in the interval [0;1]
+  // Returns a double in the interval [0;1)
   double getDouble() { return std::uniform_real_distribution<double>(0., 1.)(rng); };
 
   // Normal distributed number with mean zero.
@@ -71,5 +72,60 @@ private:
   std::mt19937 rng;
 };
 
+/// A counter-based random number generator.
+///
+/// The n'th number of a stream is a hash of the stream key and n, so the whole state is
+/// two integers: seeding is free, and independent streams can be derived from a key
+/// (see 'derive') without drawing from the parent stream.
+class CounterRandomGenerator
+{
+public:
+  CounterRandomGenerator(uint64_t key = 0)
+      : key(key)
+  {
+  }
+
+  // Returns a double in the interval [0;1)
+  double getDouble() { return (next() >> 11) * 0x1.0p-53; }
+
+  double getDouble(double min, double max) { return getDouble() * (max - min) + min; }
+
+  // Returns an integer between 0 and max (both inclusive).
+  int getInt(int max)
+  {
+    if (max <= 0)
+      return 0;
+    return int(((next() >> 32) * (uint64_t(max) + 1)) >> 32);
+  }
+
+  int getInt() { return int(uint32_t(next())); }
+
+  void setSeed(int seed)
+  {
+    key = mix(uint64_t(uint32_t(seed)) + 0x9e3779b97f4a7c15ULL);
+    counter = 0;
+  }
+
+  /// Returns a new, independent stream, identified by 'index'.
+  CounterRandomGenerator derive(uint64_t index) const
+  {
+    return CounterRandomGenerator(mix(key ^ mix(index + 0x632be59bd9b4e019ULL)));
+  }
+
+  uint64_t next() { return mix(key ^ mix(++counter * 0x9e3779b97f4a7c15ULL)); }
+
+private:
+  // SplitMix64 finalizer
+  static uint64_t mix(uint64_t z)
+  {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t key;
+  uint64_t counter{0};
+};
+
 }
 }
@@ -8,20 +8,46 @@ namespace Model
 {
 
 /// These two independent random number generator streams are used in Structure Synth
+///
+/// The streams are counter-based and carried by value in every State.
+/// The streams of a new state are derived from the state that created it,
+/// so the random numbers drawn by a state only depend on its derivation path,
+/// and not on the order states are executed in (breadth-first, depth-first or in parallel).
 class RandomStreams
 {
 public:
-  static Math::RandomNumberGenerator* Geometry() { return geometry; }
-  static Math::RandomNumberGenerator* Color() { return color; }
-  static void SetSeed(int seed)
+  /// Stream ids beyond this value are never used for child states (see 'derive').
+  static constexpr uint64_t firstReservedStream = uint64_t(1) << 32;
+
+  RandomStreams() { setSeed(0); }
+
+  Math::CounterRandomGenerator& Geometry() { return geometry; }
+  Math::CounterRandomGenerator& Color() { return color; }
+  void setSeed(int seed)
   {
-    geometry->setSeed(seed);
-    color->setSeed(seed);
+    geometry.setSeed(seed);
+    color = geometry.derive(firstReservedStream);
   }
-  // static void UseOldRandomGenerators(bool useOld) { geometry->useStdLib(useOld); color->useStdLib(useOld); }
+
+  /// Returns the streams for the 'index'th state created by the owner of these streams.
+  RandomStreams derive(uint32_t index) const
+  {
+    RandomStreams r(*this);
+    r.geometry = geometry.derive(index);
+    r.color = color.derive(index);
+    r.children = 0;
+    return r;
+  }
+
+  /// Returns the streams for the next state created by the owner of these streams.
+  /// The n'th child always gets the same streams, regardless of the order the states
+  /// are executed in.
+  RandomStreams createChild() { return derive(children++); }
+
 private:
-  static Math::RandomNumberGenerator* geometry;
-  static Math::RandomNumberGenerator* color;
+  Math::CounterRandomGenerator geometry;
+  Math::CounterRandomGenerator color;
+  uint32_t children{0}; // Number of streams handed out by 'createChild'.
 };
 
 }
@@ -0,0 +1,98 @@
+#include <ssynth/ThreadPool.h>
+
+namespace ssynth::Misc
+{
+
+ThreadPool::ThreadPool(int threads)
+{
+  for (int i = 1; i < threads; i++)
+    workers.emplace_back([this] { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock(mutex);
+    quit = true;
+  }
+  wakeUp.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& job)
+{
+  if (count <= 0)
+    return;
+
+  if (workers.empty() || count == 1)
+  {
+    for (int i = 0; i < count; i++)
+      job(i);
+    return;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    this->job = &job;
+    jobCount = count;
+    nextIndex = 0;
+    busyWorkers = (int)workers.size();
+    error = nullptr;
+    generation++;
+  }
+  wakeUp.notify_all();
+
+  work();
+
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [this] { return busyWorkers == 0; });
+  this->job = nullptr;
+
+  if (error)
+    std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void ThreadPool::work()
+{
+  for (int i = nextIndex++; i < jobCount; i = nextIndex++)
+  {
+    try
+    {
+      (*job)(i);
+    }
+    catch (...)
+    {
+      std::lock_guard lock(mutex);
+      if (!error)
+        error = std::current_exception();
+      // Skip the rest of the job.
+      nextIndex = jobCount;
+    }
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  unsigned seenGeneration = 0;
+  for (;;)
+  {
+    {
+      std::unique_lock lock(mutex);
+      wakeUp.wait(lock, [&] { return quit || generation != seenGeneration; });
+      if (quit)
+        return;
+      seenGeneration = generation;
+    }
+
+    work();
+
+    {
+      std::lock_guard lock(mutex);
+      busyWorkers--;
+    }
+    finished.notify_one();
+  }
+}
+
+}
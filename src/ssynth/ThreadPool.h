@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ssynth
+{
+namespace Misc
+{
+
+/// A fixed set of worker threads, used for executing parallel-for style jobs.
+///
+/// The calling thread takes part in the work, so a pool of size 1 has no extra threads
+/// and runs every job inline.
+class ThreadPool
+{
+public:
+  /// Constructor. 'threads' is the total number of threads working on a job
+  /// (including the calling thread). Values below 1 are treated as 1.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int size() const { return (int)workers.size() + 1; }
+
+  /// Calls 'job(i)' for every i in [0;count), distributed over the threads of the pool.
+  /// Blocks until all calls have returned.
+  /// If a call throws, the remaining indices are skipped and the first exception is
+  /// rethrown in the calling thread.
+  void run(int count, const std::function<void(int)>& job);
+
+private:
+  void workerLoop();
+  void work();
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable finished;
+
+  // State of the current job (guarded by 'mutex', except the atomics).
+  const std::function<void(int)>* job{};
+  int jobCount{};
+  std::atomic_int nextIndex{};
+  int busyWorkers{};
+  unsigned generation{};
+  bool quit{};
+  std::exception_ptr error;
+};
+
+}
+}
@@ -0,0 +1,24 @@
+# Builds SCRIPT and REFERENCE, and checks that the outputs are identical.
+# Usage: cmake -DSSYNTHGEN=<ssynthgen> -DSCRIPT=<script> -DREFERENCE=<script>
+#              -DOUTPUT_DIR=<dir> -P <this file>
+
+foreach(input SCRIPT REFERENCE)
+  set(output "${OUTPUT_DIR}/compare-${input}.ply")
+  file(REMOVE "${output}")
+  execute_process(
+    COMMAND "${SSYNTHGEN}" -o "${output}" "${${input}}"
+    RESULT_VARIABLE result
+    OUTPUT_QUIET
+    ERROR_QUIET)
+  if(NOT result EQUAL 0 OR NOT EXISTS "${output}")
+    message(FATAL_ERROR "ssynthgen failed on ${${input}}")
+  endif()
+endforeach()
+
+execute_process(
+  COMMAND "${CMAKE_COMMAND}" -E compare_files
+          "${OUTPUT_DIR}/compare-SCRIPT.ply" "${OUTPUT_DIR}/compare-REFERENCE.ply"
+  RESULT_VARIABLE different)
+if(different)
+  message(FATAL_ERROR "The outputs of ${SCRIPT} and ${REFERENCE} differ")
+endif()
@@ -0,0 +1,24 @@
+# Builds SCRIPT serially and with the parallel generation executor, and checks that
+# the outputs are identical.
+# Usage: cmake -DSSYNTHGEN=<ssynthgen> -DSCRIPT=<script> -DOUTPUT_DIR=<dir> -P <this file>
+
+foreach(threads 0 4)
+  set(output "${OUTPUT_DIR}/threads-${threads}.ply")
+  file(REMOVE "${output}")
+  execute_process(
+    COMMAND "${SSYNTHGEN}" -j ${threads} -o "${output}" "${SCRIPT}"
+    RESULT_VARIABLE result
+    OUTPUT_QUIET
+    ERROR_QUIET)
+  if(NOT result EQUAL 0 OR NOT EXISTS "${output}")
+    message(FATAL_ERROR "ssynthgen -j ${threads} failed on ${SCRIPT}")
+  endif()
+endforeach()
+
+execute_process(
+  COMMAND "${CMAKE_COMMAND}" -E compare_files
+          "${OUTPUT_DIR}/threads-0.ply" "${OUTPUT_DIR}/threads-4.ply"
+  RESULT_VARIABLE different)
+if(different)
+  message(FATAL_ERROR "The output of ${SCRIPT} depends on the thread count")
+endif()
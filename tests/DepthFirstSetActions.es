@@ -0,0 +1,22 @@
+// 'set' actions below rules without any, in a depth-first traversal.
+// All the children of a rule are created before any of them is executed, so the boxes
+// created after the R3 subtree still use the first color pool: the output must be the
+// same as the one of DepthFirstSetActionsReference.es, where R3 keeps that pool.
+set recursion depth
+set colorpool randomrgb
+R1
+
+rule R1 {
+  { x 1 } R2
+  { y 1 color random } box
+}
+
+rule R2 {
+  { z 1 } R3
+  { x 1 color random } box
+}
+
+rule R3 {
+  { s 0.5 color random } box
+  set colorpool greyscale
+}
@@ -0,0 +1,19 @@
+// DepthFirstSetActions.es, where the 'set' action keeps the color pool.
+set recursion depth
+set colorpool randomrgb
+R1
+
+rule R1 {
+  { x 1 } R2
+  { y 1 color random } box
+}
+
+rule R2 {
+  { z 1 } R3
+  { x 1 color random } box
+}
+
+rule R3 {
+  { s 0.5 color random } box
+  set colorpool randomrgb
+}
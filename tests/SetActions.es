@@ -0,0 +1,22 @@
+// 'set' actions executed in the middle of breadth-first generations.
+set maxdepth 9
+R1
+
+rule R1 {
+  { x 1 hue 10 } R2
+  { y 1 color random } box
+  { z 1 } R2
+}
+
+rule R2 {
+  { s 0.8 rz 20 color random } R1
+  set colorpool randomrgb
+  { x 0.5 color random } box
+}
+
+rule R2 w 0.5 {
+  set maxsize 2
+  { s 1.3 ry 30 } R1
+  { color random } box
+  set colorpool greyscale
+}